@@ -26,6 +26,7 @@
 */
 /*********************************************************************************/
 
+#include <string.h>
 #include "Bar.h"
 
 #define OPTION_DEBUG_BAR     0
@@ -94,6 +95,16 @@ int CBar::goToBarNumer()
 
 }
 
+void CBar::setBarStart(int bar, int top, int bottom)
+{
+    setTimeSig(top, bottom);
+    m_deltaTime = 0;
+    m_beatCounter = 0;
+    m_barCounter = bar;
+    m_eventBits |= EVENT_BITS_newBarNumber;
+    checkGotoBar();
+}
+
 void CBar::checkGotoBar()
 {
     double currentBar = getCurrentBarPos();
@@ -140,3 +151,212 @@ void CBar::setLoopingBars(double bars)
     setupEnableFlags();
     checkGotoBar();
 }
+
+// Bank select comes first so it is sent before the program change. Reset all controllers and the
+// RPN/NRPN data entry controllers are left out, they would undo or scramble the others.
+const int CBarIndex::chaseControls[CHASE_CONTROL_COUNT] =
+{
+    0,                  // Bank select
+    32,                 // Bank select LSB
+    1,                  // Modulation
+    MIDI_MAIN_VOLUME,
+    10,                 // Pan
+    11,                 // Expression
+    MIDI_SUSTAIN,
+    91,                 // Reverb
+    93,                 // Chorus
+};
+#define CHASE_BANK_SELECT_COUNT 2
+
+// The value each controller has after a reset, -1 if it is left alone when the song has not set it
+const int CBarIndex::chaseDefaults[CHASE_CONTROL_COUNT] =
+{
+    -1,                 // Bank select
+    -1,                 // Bank select LSB
+    0,                  // Modulation
+    100,                // Volume
+    64,                 // Pan
+    127,                // Expression
+    0,                  // Sustain
+    -1,                 // Reverb
+    -1,                 // Chorus
+};
+
+void CBarIndex::clear()
+{
+    m_bars.clear();
+    m_currentTick = 0;
+    m_eventCount = 0;
+    m_nextBarTick = 0;
+    // The same as CBar when there is no time signature
+    m_timeSigTop = 4;
+    m_timeSigBottom = 4;
+    m_hasKeySig = false;
+    m_keySig = 0;
+    m_majorKey = 0;
+    memset(&m_chaseState, -1, sizeof(m_chaseState));
+    m_chaseState.usedChannels = 0;
+    m_chaseStateChanged = true;
+    m_chaseSnapshots.clear();
+}
+
+// The bars are counted in the same way as CBar counts them
+int CBarIndex::barLength()
+{
+    int beatLength = (CMidiFile::getPulsesPerQuarterNote() * 4) / m_timeSigBottom;
+    if (beatLength <= 0 || m_timeSigTop <= 0)
+        return CMidiFile::getPulsesPerQuarterNote() * 4;
+    return beatLength * m_timeSigTop;
+}
+
+void CBarIndex::examineMidiEvent(CMidiEvent event)
+{
+    m_currentTick += event.deltaTime();
+
+    // This event is the first one in each bar that has started since the last event
+    while (m_currentTick >= m_nextBarTick)
+    {
+        barIndexEntry_t bar;
+        bar.tick = m_nextBarTick;
+        bar.eventIndex = m_eventCount;
+        bar.eventTick = m_currentTick;
+        bar.timeSigTop = m_timeSigTop;
+        bar.timeSigBottom = m_timeSigBottom;
+        bar.hasKeySig = m_hasKeySig;
+        bar.keySig = m_keySig;
+        bar.majorKey = m_majorKey;
+        if (m_chaseStateChanged)
+        {
+            m_chaseSnapshots.push_back(m_chaseState);
+            m_chaseStateChanged = false;
+        }
+        bar.chaseIndex = static_cast<int>(m_chaseSnapshots.size()) - 1;
+        m_bars.push_back(bar);
+        m_nextBarTick += barLength();
+    }
+    m_eventCount++;
+
+    if (event.type() == MIDI_PB_timeSignature && event.data1() > 0 && event.data2() > 0)
+    {
+        m_timeSigTop = event.data1();
+        m_timeSigBottom = event.data2();
+        // A time signature at the start of a bar changes that bar, otherwise it starts with the next bar
+        barIndexEntry_t& bar = m_bars.back();
+        if (bar.tick == m_currentTick)
+        {
+            bar.timeSigTop = m_timeSigTop;
+            bar.timeSigBottom = m_timeSigBottom;
+            m_nextBarTick = bar.tick + barLength();
+        }
+    }
+    else if (event.type() == MIDI_PB_keySignature)
+    {
+        m_hasKeySig = true;
+        m_keySig = event.data1();
+        m_majorKey = event.data2();
+    }
+    else
+        chaseMidiEvent(event);
+}
+
+// Keeps track of the state of each channel
+void CBarIndex::chaseMidiEvent(CMidiEvent& event)
+{
+    int chan = event.channel();
+    int i;
+
+    if (chan < 0 || chan >= MAX_MIDI_CHANNELS)
+        return;
+
+    // Only the voice messages are sent to a channel
+    if (event.type() >= MIDI_NOTE_OFF && event.type() <= MIDI_PITCH_BEND && (m_chaseState.usedChannels & (1 << chan)) == 0)
+    {
+        m_chaseState.usedChannels |= 1 << chan;
+        m_chaseStateChanged = true;
+    }
+
+    switch (event.type())
+    {
+    case MIDI_PROGRAM_CHANGE:
+        m_chaseState.program[chan] = event.programme() & 0x7f;
+        break;
+
+    case MIDI_PITCH_BEND:
+        m_chaseState.pitchBend[chan] = ((event.data2() & 0x7f) << 7) | (event.data1() & 0x7f);
+        break;
+
+    case MIDI_CONTROL_CHANGE:
+        if (event.data1() == MIDI_RESET_ALL_CONTROLLERS)
+        {
+            // This does not reset the bank, volume and pan
+            for (i = 0; i < CHASE_CONTROL_COUNT; i++)
+            {
+                if (chaseControls[i] == 1 || chaseControls[i] == 11 || chaseControls[i] == MIDI_SUSTAIN)
+                    m_chaseState.controls[chan][i] = -1;
+            }
+            m_chaseState.pitchBend[chan] = -1;
+            break;
+        }
+        for (i = 0; i < CHASE_CONTROL_COUNT; i++)
+        {
+            if (event.data1() == chaseControls[i])
+            {
+                m_chaseState.controls[chan][i] = event.data2() & 0x7f;
+                break;
+            }
+        }
+        if (i == CHASE_CONTROL_COUNT)
+            return;
+        break;
+
+    default:
+        return;
+    }
+    m_chaseStateChanged = true;
+}
+
+void CBarIndex::getChaseEvents(const barIndexEntry_t& entry, vector<CMidiEvent>* events)
+{
+    CMidiEvent event;
+    int chan;
+    int i;
+    int value;
+
+    events->clear();
+    if (entry.chaseIndex < 0 || entry.chaseIndex >= static_cast<int>(m_chaseSnapshots.size()))
+        return;
+    const chaseSnapshot_t& state = m_chaseSnapshots[entry.chaseIndex];
+
+    for (chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        // The song has not got to this channel yet, so there is nothing to put back
+        if ((state.usedChannels & (1 << chan)) == 0)
+            continue;
+        for (i = 0; i < CHASE_CONTROL_COUNT; i++)
+        {
+            // The program change goes after the bank select
+            if (i == CHASE_BANK_SELECT_COUNT && state.program[chan] >= 0)
+            {
+                event.programChangeEvent(0, chan, state.program[chan]);
+                events->push_back(event);
+            }
+            value = (state.controls[chan][i] >= 0) ? state.controls[chan][i] : chaseDefaults[i];
+            if (value >= 0)
+            {
+                event.controlChangeEvent(0, chan, chaseControls[i], value);
+                events->push_back(event);
+            }
+        }
+        value = (state.pitchBend[chan] >= 0) ? state.pitchBend[chan] : CHASE_PITCH_BEND_CENTRE;
+        event.pitchBendEvent(0, chan, value & 0x7f, value >> 7);
+        events->push_back(event);
+    }
+}
+
+bool CBarIndex::findBar(int bar, barIndexEntry_t* entry)
+{
+    if (bar < 0 || bar >= getBarCount())
+        return false;
+    *entry = m_bars[bar];
+    return true;
+}
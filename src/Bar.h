@@ -72,6 +72,7 @@ public:
         setupEnableFlags();
     }
 
+    double getPlayFromBar(){ return m_playFromBar;}
     void setPlayUptoBar(double bar);
     double getPlayUptoBar(){ return m_playUptoBar;}
     void setLoopingBars(double bars);
@@ -111,6 +112,9 @@ public:
 
     int goToBarNumer();
 
+    // Moves straight to the start of a bar (rather than counting the ticks up to it)
+    void setBarStart(int bar, int top, int bottom);
+
 private:
     void checkGotoBar();
     void setupEnableFlags()
@@ -143,5 +147,73 @@ private:
 
 };
 
+// The controllers that are chased when playing starts part way through a song
+#define CHASE_CONTROL_COUNT 9
+#define CHASE_PITCH_BEND_CENTRE 8192
+
+// The state of every channel (as set by the song) at the start of a bar, -1 means it has not been set
+typedef struct
+{
+    signed char program[MAX_MIDI_CHANNELS];
+    signed char controls[MAX_MIDI_CHANNELS][CHASE_CONTROL_COUNT];
+    short pitchBend[MAX_MIDI_CHANNELS];
+    unsigned int usedChannels;  // A bit for each channel the song has sent anything to, only these are chased
+} chaseSnapshot_t;
+
+// Where a bar starts in the song
+typedef struct
+{
+    int tick;           // In midi ticks from the start of the song
+    int eventIndex;     // The number of song events before the bar
+    int eventTick;      // The tick of the first event at or after the start of the bar
+    int timeSigTop;     // The time signature of the bar
+    int timeSigBottom;
+    bool hasKeySig;     // Set if there was a key signature before the bar
+    int keySig;         // The last key signature before the bar
+    int majorKey;
+    int chaseIndex;     // The state of the channels at the start of the bar
+} barIndexEntry_t;
+
+// Finds where every bar starts when the song is loaded, so playing can start
+// from a bar without playing through all the bars before it
+class CBarIndex
+{
+public:
+    CBarIndex() { clear(); }
+
+    void clear();
+
+    // Called for every event of the (merged) song, in order, when the song is loaded
+    void examineMidiEvent(CMidiEvent event);
+
+    // Returns false if the song does not have that many bars
+    bool findBar(int bar, barIndexEntry_t* entry);
+    int getBarCount() { return static_cast<int>(m_bars.size()); }
+
+    // The program, controller and pitch bend events needed to get the channels used so far to where they are at the
+    // start of a bar, the controllers the song has not set (or has reset) by then are put back to their defaults
+    void getChaseEvents(const barIndexEntry_t& entry, vector<CMidiEvent>* events);
+
+private:
+    int barLength();
+    void chaseMidiEvent(CMidiEvent& event);
+
+    static const int chaseControls[CHASE_CONTROL_COUNT];
+    static const int chaseDefaults[CHASE_CONTROL_COUNT];
+
+    vector<barIndexEntry_t> m_bars;     // Indexed by the bar number
+    int m_currentTick;
+    int m_eventCount;
+    int m_nextBarTick;
+    int m_timeSigTop;
+    int m_timeSigBottom;
+    bool m_hasKeySig;
+    int m_keySig;
+    int m_majorKey;
+    chaseSnapshot_t m_chaseState;           // The state of the channels after the last event
+    bool m_chaseStateChanged;
+    vector<chaseSnapshot_t> m_chaseSnapshots;  // A snapshot is only added when the state has changed
+};
+
 #endif  // __BAR_H__
 
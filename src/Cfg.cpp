@@ -43,6 +43,8 @@ bool Cfg::experimentalNoteLength = false;
 bool Cfg::useLogFile = false;
 bool Cfg::midiInputDump = false;
 int Cfg::keyboardLightsChan = -1;
+int Cfg::streamingHorizon = 0;
+int Cfg::outputLookAhead = 30;
 
 int Cfg::experimentalSwapInterval = -1;
 int Cfg::tickRate;
@@ -146,6 +146,8 @@ public:
     static bool useLogFile;
     static bool midiInputDump;
     static int keyboardLightsChan;
+    static int streamingHorizon; // in quarter notes, 0 decodes the whole song when it is loaded
+    static int outputLookAhead;  // in msec, how early the song events are scheduled, 0 plays them as they are reached
 
 private:
     static float m_staveEndX;
@@ -26,6 +26,7 @@
 */
 /*********************************************************************************/
 
+#include <algorithm>
 #include "Chord.h"
 #include "Cfg.h"
 
@@ -192,3 +193,32 @@ bool CFindChord::findChord(CMidiEvent midi, int channel, whichPart_t part)
     return foundChord;
 }
 
+void CChordList::build(const CMidiEvent* events, size_t eventCount, int channel)
+{
+    CFindChord findChord;
+    chordListEntry_t entry;
+    int tick = 0;
+
+    m_channel = channel;
+    m_leftHandChannel = CNote::leftHandChan();
+    m_rightHandChannel = CNote::rightHandChan();
+    m_chords.clear();
+
+    for (size_t i = 0; i < eventCount; i++)
+    {
+        if (findChord.findChord(events[i], channel, PB_PART_both) == true)
+        {
+            entry.chord = findChord.getChord();
+            // The delta time of a chord is from the chord before
+            tick += entry.chord.getDeltaTime();
+            entry.tick = tick;
+            entry.eventIndex = i;
+            m_chords.push_back(entry);
+        }
+    }
+}
+
+size_t CChordList::findChord(int tick)
+{
+    return lower_bound(m_chords.begin(), m_chords.end(), tick, entryBeforeTick) - m_chords.begin();
+}
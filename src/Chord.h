@@ -207,5 +207,54 @@ private:
     int m_cfg_ChordMaxLength;
 };
 
+// All the chords in a song for one channel (and the current left and right hand channels),
+// found once rather than one event at a time as the song is played
+class CChordList
+{
+public:
+    CChordList()
+    {
+        m_channel = -1;
+        m_leftHandChannel = -2;
+        m_rightHandChannel = -2;
+    }
+
+    void build(const CMidiEvent* events, size_t eventCount, int channel);
+
+    // True if the list was built for this channel and the channels currently used by each hand,
+    // both hands of the piano part share the same list
+    bool isFor(int channel)
+    {
+        if (CNote::leftHandChan() != m_leftHandChannel || CNote::rightHandChan() != m_rightHandChannel)
+            return false;
+        return (channel == m_channel || (CNote::hasPianoPart(channel) && CNote::hasPianoPart(m_channel)));
+    }
+
+    size_t size() { return m_chords.size(); }
+    CChord getChord(size_t index) { return m_chords[index].chord; }
+    // The time of the chord in midi ticks from the start of the song
+    int getTick(size_t index) { return m_chords[index].tick; }
+    // The index of the song event that completes the chord (which is when CFindChord finds it)
+    size_t getEventIndex(size_t index) { return m_chords[index].eventIndex; }
+
+    // The first chord at or after a tick
+    size_t findChord(int tick);
+
+private:
+    typedef struct
+    {
+        int tick;
+        size_t eventIndex;
+        CChord chord;
+    } chordListEntry_t;
+
+    static bool entryBeforeTick(const chordListEntry_t& entry, int tick) { return entry.tick < tick; }
+
+    vector<chordListEntry_t> m_chords;
+    int m_channel;
+    int m_leftHandChannel;
+    int m_rightHandChannel;
+};
+
 #endif  // __CHORD_H__
 
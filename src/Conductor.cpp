@@ -35,8 +35,6 @@
 
 
 #include "Conductor.h"
-#include "Score.h"
-#include "Piano.h"
 #include "Cfg.h"
 
 playMode_t CConductor::m_playMode = PB_PLAY_MODE_listen;
@@ -45,14 +43,16 @@ CConductor::CConductor()
 {
     int i;
 
-    m_scoreWin = 0;
-    m_settings = 0;
-    m_piano = 0;
+    m_scoreWin = &m_headlessScore;
+    m_settings = &m_headlessSettings;
+    m_piano = &m_headlessPiano;
 
     m_songEventQueue = new CQueue<CMidiEvent>(1000);
     m_wantedChordQueue = new CQueue<CChord>(1000);
     m_savedNoteQueue = new CQueue<CMidiEvent>(200);
     m_savedNoteOffQueue = new CQueue<CMidiEvent>(200);
+    m_loopStartSongEvents = new CQueue<CMidiEvent>(1000);
+    m_loopStartChords = new CQueue<CChord>(1000);
     m_playing = false;
     m_transpose = 0;
     m_latencyFix = 0;
@@ -64,6 +64,9 @@ CConductor::CConductor()
     m_activeChannel = 0;
     m_skill = 0;
     m_silenceTimeOut = 0;
+    m_inputAgeTicks = 0;
+    m_inputChordAge = 0;
+    m_outputTime = -1;
     m_realTimeEventBits = 0;
     m_mutePianistPart = false;
     setPianistChannels(1-1,2-1);
@@ -91,6 +94,8 @@ CConductor::~CConductor()
     delete m_wantedChordQueue;
     delete m_savedNoteQueue;
     delete m_savedNoteOffQueue;
+    delete m_loopStartSongEvents;
+    delete m_loopStartChords;
 }
 
 void CConductor::reset()
@@ -141,6 +146,8 @@ void CConductor::allSoundOff()
 {
     int channel;
 
+    // Don't let any notes that are scheduled start again after they have been silenced
+    flushScheduledMidiEvents();
     for ( channel = 0; channel < MAX_MIDI_CHANNELS; channel++)
     {
         if (channel != m_pianistGoodChan)
@@ -423,14 +430,20 @@ void CConductor::playMusic(bool start)
 
 // This will allow us to map midi tracks onto midi channels
 // tacks will eventually allow for more than the 16 midi channels (eg with two mid devices)
+// The "track" is the event's midi channel, the song events do not carry the track they came from
 void CConductor::playTrackEvent(CMidiEvent event)
 {
     int track = event.channel();
+    if (track < 0 || track >= MAX_MIDI_TRACKS)
+        return;
     int chan = track2Channel(track);
     if (chan == -1)
         return;
     event.setChannel(chan);
-    playMidiEvent(event);
+    if (m_outputTime >= 0)
+        scheduleMidiEvent(event, m_outputTime);
+    else
+        playMidiEvent(event);
 }
 
 void CConductor::playTransposeEvent(CMidiEvent event)
@@ -452,7 +465,8 @@ void CConductor::playTransposeEvent(CMidiEvent event)
         playTrackEvent(event); // Play the midi note or event
     else
     {
-        if (event.type() == MIDI_PROGRAM_CHANGE || event.type() == MIDI_CONTROL_CHANGE)
+        if (event.type() == MIDI_PROGRAM_CHANGE || event.type() == MIDI_CONTROL_CHANGE ||
+                event.type() == MIDI_PITCH_BEND)
             playTrackEvent(event); // Play the midi note or event
     }
 }
@@ -485,9 +499,6 @@ void CConductor::resetWantedChord()
 // switch modes if we are playing well enough (i.e. don't slow down if we are playing late)
 void CConductor::setFollowSkillAdvanced(bool enable)
 {
-    if (m_settings==0 || m_scoreWin == 0)
-        return;
-
     m_settings-> setAdvancedMode(enable);
 
     if (getLatencyFix() > 0)
@@ -584,7 +595,7 @@ void CConductor::fetchNextChord()
 
 bool CConductor::validatePianistNote( const CMidiEvent & inputNote)
 {
-    if ( m_chordDeltaTime <= -m_cfg_playZoneEarly)
+    if ( m_chordDeltaTime - m_inputChordAge <= -m_cfg_playZoneEarly)
         return false;
 
     return m_wantedChord.searchChord(inputNote.note(), m_transpose);
@@ -711,12 +722,12 @@ void CConductor::pianistInput(CMidiEvent inputNote)
             m_piano->addPianistNote(hand, inputNote,true);
             int pianistTiming;
             if  ( ( cfg_timingMarkersFlag && m_followSkillAdvanced ) || m_playMode == PB_PLAY_MODE_rhythmTapping )
-                pianistTiming = m_pianistTiming;
+                pianistTiming = m_pianistTiming - m_inputAgeTicks;
             else
                 pianistTiming = NOT_USED;
             m_scoreWin->setPlayedNoteColour(inputNote.note(),
                         (!m_followPlayingTimeOut)? Cfg::playedGoodColour():Cfg::playedBadColour(),
-                        m_chordDeltaTime, pianistTiming);
+                        m_chordDeltaTime - m_inputChordAge, pianistTiming);
 
             if (validatePianistChord() == true)
             {
@@ -835,7 +846,14 @@ void CConductor::addDeltaTime(int ticks)
 void CConductor::followPlaying()
 {
     if ( m_playMode == PB_PLAY_MODE_listen )
+    {
+        // Nobody plays the chords, so pass them by as they are reached. Otherwise the queue
+        // fills up and the song stops being read
+        while (m_wantedChordQueue->length() > 0 &&
+                m_chordDeltaTime >= m_wantedChordQueue->index(0).getDeltaTime() * SPEED_ADJUST_FACTOR)
+            m_chordDeltaTime -= m_wantedChordQueue->pop().getDeltaTime() * SPEED_ADJUST_FACTOR;
         return;
+    }
 
     if (m_wantedChord.length() == 0)
         fetchNextChord();
@@ -911,26 +929,41 @@ void CConductor::missedNotesColour(CColour colour)
     }
 }
 
-void CConductor::realTimeEngine(int mSecTicks)
+void CConductor::realTimeEngine(qint64 nSecTicks)
 {
     int type;
     int ticks; // Midi ticks
 
-    //mSecTicks = 2; // for debugging only
+    //nSecTicks = 2 * NANO_SECONDS_PER_MSEC; // for debugging only
 
-    ticks = m_tempo.mSecToTicks(mSecTicks);
+    ticks = m_tempo.nSecToTicks(nSecTicks);
 
     if (!m_followPlayingTimeOut)
         m_pianistTiming += ticks;
 
+    // The notes are judged by when they were played, not by when this frame got round to them
+    qint64 now = getTimeMicros();
     while (checkMidiInput() > 0)
-        expandPianistInput(readMidiInput());
+    {
+        CMidiEvent inputNote = readMidiInput();
+        qint64 inputTime = getMidiInputTime();
+        int ageTicks = (inputTime >= 0 && now > inputTime) ? m_tempo.uSecToTicks(now - inputTime) : 0;
+        m_inputAgeTicks = (!m_followPlayingTimeOut) ? qMin(ageTicks, ticks) : 0;
+        // The chord time only moved on this frame if the song is playing
+        if (m_playing && getfollowState() != PB_FOLLOW_waiting && !seekingBarNumber())
+            m_inputChordAge = qMin(ageTicks, ticks);
+        else
+            m_inputChordAge = 0;
+        expandPianistInput(inputNote);
+    }
+    m_inputAgeTicks = 0;
+    m_inputChordAge = 0;
 
     if (getfollowState() == PB_FOLLOW_waiting )
     {
         if (m_silenceTimeOut > 0)
         {
-            m_silenceTimeOut -= mSecTicks;
+            m_silenceTimeOut -= nSecTicks;
             if (m_silenceTimeOut <= 0)
             {
                 allSoundOff();
@@ -956,7 +989,7 @@ void CConductor::realTimeEngine(int mSecTicks)
                 // Don't keep any saved notes off if there are no notes down
                 if (m_piano->pianistAllNotesDown() == 0)
                     outputSavedNotesOff();
-                m_silenceTimeOut = Cfg::silenceTimeOut();
+                m_silenceTimeOut = static_cast<qint64>(Cfg::silenceTimeOut()) * NANO_SECONDS_PER_MSEC;
             }
         }
         return;
@@ -989,10 +1022,24 @@ void CConductor::realTimeEngine(int mSecTicks)
 
     addDeltaTime(ticks);
 
+    // When the pianist can't hold up the song, the events are passed on a little before they are due
+    // along with the time they are due, so they are played on time however late this frame runs
+    int lookAheadTicks = 0;
+    if (Cfg::outputLookAhead > 0 && !seekingBarNumber() &&
+            (m_playMode == PB_PLAY_MODE_listen || m_playMode == PB_PLAY_MODE_playAlong))
+        lookAheadTicks = m_tempo.mSecToTicks(Cfg::outputLookAhead);
+
     followPlaying();
-    while ( m_playingDeltaTime >= m_leadLagAdjust)
+    while ( m_playingDeltaTime >= m_leadLagAdjust - lookAheadTicks)
     {
         type = m_nextMidiEvent.type();
+        // The tempo, time signature and end of the song change how the song is played from their
+        // time on, so they wait until they are due and nothing after them is read ahead before then
+        if (lookAheadTicks > 0 && m_playingDeltaTime < m_leadLagAdjust &&
+                (type == MIDI_PB_tempo || type == MIDI_PB_timeSignature || type == MIDI_PB_EOF))
+            break;
+        if (lookAheadTicks > 0)
+            m_outputTime = now + m_tempo.ticksToUSec(qMax(m_leadLagAdjust - m_playingDeltaTime, 0));
 
         if (m_songEventQueue->length() == 0 && type == MIDI_PB_EOF)
         {
@@ -1004,8 +1051,13 @@ void CConductor::realTimeEngine(int mSecTicks)
 
         if (type == MIDI_PB_tempo)
         {
-            m_tempo.setMidiTempo(m_nextMidiEvent.data1());
+            int pastTicks = m_playingDeltaTime - m_leadLagAdjust;
+            int oldTempo = m_tempo.getMidiTempo();
+            m_tempo.setMidiTempo(m_nextMidiEvent.tempo());
             m_leadLagAdjust = m_tempo.mSecToTicks( -getLatencyFix() );
+            // The clock went past the tempo change at the old tempo, or the song slowly drifts
+            if (pastTicks > 0 && !seekingBarNumber())
+                addDeltaTime(m_leadLagAdjust + m_tempo.retimeTicks(pastTicks, oldTempo) - m_playingDeltaTime);
         }
         else if (type == MIDI_PB_timeSignature)
         {
@@ -1058,6 +1110,36 @@ void CConductor::realTimeEngine(int mSecTicks)
         m_playingDeltaTime -= m_nextMidiEvent.deltaTime() * SPEED_ADJUST_FACTOR;
         followPlaying();
     }
+    m_outputTime = -1;
+}
+
+void CConductor::jumpToBar(int bar, const barIndexEntry_t& entry)
+{
+    m_bar.setBarStart(bar, entry.timeSigTop, entry.timeSigBottom);
+    m_tempo.setMidiTempo(getTempoMap()->getTempo(entry.tick));
+    m_leadLagAdjust = m_tempo.mSecToTicks( -getLatencyFix() );
+    setEventBits( m_bar.readEventBits());
+
+    // Put the programs and controllers back to where they would have been
+    vector<CMidiEvent> chaseEvents;
+    m_barIndex.getChaseEvents(entry, &chaseEvents);
+    for (size_t i = 0; i < chaseEvents.size(); i++)
+        playTransposeEvent(chaseEvents[i]);
+}
+
+void CConductor::saveLoopStart()
+{
+    *m_loopStartSongEvents = *m_songEventQueue;
+    *m_loopStartChords = *m_wantedChordQueue;
+}
+
+void CConductor::restoreLoopStart(int bar, const barIndexEntry_t& entry)
+{
+    allSoundOff();
+    rewind();
+    jumpToBar(bar, entry);
+    *m_songEventQueue = *m_loopStartSongEvents;
+    *m_wantedChordQueue = *m_loopStartChords;
 }
 
 void CConductor::rewind()
@@ -1081,8 +1163,7 @@ void CConductor::rewind()
     m_bar.rewind();
 
     m_goodPlayedNotes.clear();  // The good notes the pianist plays
-    if (m_piano)
-        m_piano->clear();
+    m_piano->clear();
     resetWantedChord();
     setFollowSkillAdvanced(false);
 
@@ -1097,12 +1178,12 @@ void CConductor::rewind()
     m_cfg_playZoneLate = CMidiFile::ppqnAdjust(Cfg::playZoneLate()) * SPEED_ADJUST_FACTOR;
 }
 
-void CConductor::init2(CScore * scoreWin, CSettings* settings)
+void CConductor::init2(CScoreObserver * scoreWin, CSettingsObserver* settings)
 {
     int channel;
 
-    m_scoreWin = scoreWin;
-    m_settings = settings;
+    m_scoreWin = (scoreWin != 0) ? scoreWin : &m_headlessScore;
+    m_settings = (settings != 0) ? settings : &m_headlessSettings;
 
     setFollowSkillAdvanced(false);
 
@@ -1111,12 +1192,10 @@ void CConductor::init2(CScore * scoreWin, CSettings* settings)
     for ( channel = 0; channel < MAX_MIDI_CHANNELS; channel++)
         muteChannel(channel, false);
 
-    assert(m_scoreWin);
-    if (m_scoreWin)
-    {
-        m_scoreWin->setRatingObject(&m_rating);
-        m_piano = m_scoreWin->getPianoObject();
-    }
+    m_scoreWin->setRatingObject(&m_rating);
+    m_piano = m_scoreWin->getPianoObject();
+    if (m_piano == 0)
+        m_piano = &m_headlessPiano;
 
 
     rewind();
@@ -37,10 +37,8 @@
 #include "Rating.h"
 #include "Tempo.h"
 #include "Bar.h"
-
-class CScore;
-class CPiano;
-class CSettings;
+#include "PianistNotes.h"
+#include "ConductorObserver.h"
 
 typedef enum {
     PB_FOLLOW_searching,
@@ -80,7 +78,8 @@ public:
     CConductor();
     ~CConductor();
 
-    void init2(CScore * scoreWin, CSettings* settings);
+    // The score and settings are told what is happening, either can be 0 when there is no display
+    void init2(CScoreObserver * scoreWin, CSettingsObserver* settings);
 
 
     //! add a midi event to be analysed and played
@@ -100,7 +99,8 @@ public:
     //! rest the conductor between each song
     void reset();
 
-    void realTimeEngine(int mSecTicks);
+    // Move the song on by the time since the last call, in nanoseconds
+    void realTimeEngine(qint64 nSecTicks);
     void playMusic(bool start);
     bool playingMusic() {return m_playing;}
 
@@ -117,6 +117,11 @@ public:
     }
     int getLatencyFix() { return m_latencyFix; }
 
+    // Convert between song ticks and the time from the start of the song at the current speed
+    qint64 tickToMicros(int tick) { return m_tempo.tickToMicros(tick); }
+    int microsToTick(qint64 micros) { return m_tempo.microsToTick(micros); }
+    qint64 getSongLengthMicros() { return m_tempo.tickToMicros(m_tempo.getTempoMap()->getSongTicks()); }
+
     void muteChannel(int channel, bool state);
     void mutePart(int channel, bool state);
     void transpose(int transpose);
@@ -192,6 +197,7 @@ public:
     double getCurrentBarPos(){ return m_bar.getCurrentBarPos();}
 
     void setPlayFromBar(double bar){ m_bar.setPlayFromBar(bar);}
+    double getPlayFromBar(){ return m_bar.getPlayFromBar();}
     void setPlayUptoBar(double bar){ m_bar.setPlayUptoBar(bar);}
     double getPlayUptoBar(){ return m_bar.getPlayUptoBar();}
     void setLoopingBars(double bars){ m_bar.setLoopingBars(bars);}
@@ -209,8 +215,8 @@ public:
 
 
 protected:
-    CScore* m_scoreWin;
-    CSettings* m_settings;
+    CScoreObserver* m_scoreWin;
+    CSettingsObserver* m_settings;
 
     CQueue<CMidiEvent>* m_songEventQueue;
     CQueue<CChord>* m_wantedChordQueue;
@@ -231,6 +237,18 @@ protected:
 
     int track2Channel(int track) {return m_track2ChannelLookUp[track];}
 
+    // Built when the song is loaded
+    CTempoMap* getTempoMap() { return m_tempo.getTempoMap(); }
+    CBarIndex* getBarIndex() { return &m_barIndex; }
+
+    // Start playing at the start of a bar, all the song events before the bar must have been skipped
+    void jumpToBar(int bar, const barIndexEntry_t& entry);
+
+    // Keeps the events that are queued at the start of a loop, so each time round the loop
+    // starts with a copy of them rather than reading them all again
+    void saveLoopStart();
+    void restoreLoopStart(int bar, const barIndexEntry_t& entry);
+
 
 
 
@@ -277,6 +295,8 @@ private:
     CRating m_rating;
     CQueue<CMidiEvent>* m_savedNoteQueue;
     CQueue<CMidiEvent>* m_savedNoteOffQueue;
+    CQueue<CMidiEvent>* m_loopStartSongEvents;
+    CQueue<CChord>* m_loopStartChords;
     CMidiEvent m_nextMidiEvent;
     bool m_muteChannels[MAX_MIDI_CHANNELS];
     bool isChannelMuted(int chan)
@@ -287,11 +307,16 @@ private:
     }
     void setFollowSkillAdvanced(bool enable);
 
-    CPiano* m_piano;
+    CPianistNotes* m_piano;
+    // Used in place of the display and the settings when there are none
+    CScoreObserver m_headlessScore;
+    CSettingsObserver m_headlessSettings;
+    CPianistNotes m_headlessPiano;
 
     CBar m_bar;
+    CBarIndex m_barIndex;
     int m_leadLagAdjust; // Synchronise the sound the the video
-    int m_silenceTimeOut; // used to create silence if the student stops for toooo long
+    qint64 m_silenceTimeOut; // used to create silence if the student stops for toooo long (nSec)
     CChord m_wantedChord;  // The chord the pianist needs to play
     CChord m_savedWantedChord; // A copy of the wanted chord complete with both left and right parts
     CChord m_goodPlayedNotes;  // The good notes the pianist plays
@@ -317,6 +342,10 @@ private:
     int m_cfg_rhythmTapRightHandDrumSound;
 
     int m_pianistTiming;  //measure whether the pianist is playing early or late
+    // How long ago (in ticks) the midi input note being processed was really played
+    int m_inputAgeTicks;    // on the m_pianistTiming clock
+    int m_inputChordAge;    // on the m_chordDeltaTime clock
+    qint64 m_outputTime;    // When the song event being played is due (see ppTimeMicros()), -1 to play it now
     bool m_followPlayingTimeOut;  // O dear, the student is too slow
 
     bool m_testWrongNoteSound;
@@ -0,0 +1,83 @@
+/*********************************************************************************/
+/*!
+@file           ConductorObserver.h
+
+@brief          The hooks the conductor uses to tell the score and the settings what is happening.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __CONDUCTOR_OBSERVER_H__
+#define __CONDUCTOR_OBSERVER_H__
+
+#include "MidiEvent.h"
+#include "Cfg.h"
+#include "StavePosition.h"
+
+class CRating;
+class CPianistNotes;
+
+/*!
+ * @brief   The score display, as seen by the conductor and the song.
+ *
+ * Every hook does nothing by default, so the engine can be run without a display
+ * (the conductor uses one of these when it is not given a score).
+ */
+class CScoreObserver
+{
+public:
+    virtual ~CScoreObserver() {}
+
+    //! add a midi event to be analysed and displayed on the score
+    virtual void midiEventInsert(CMidiEvent event) {}
+    //! first check if there is space to add a midi event
+    virtual int midiEventSpace() { return 1000; }
+
+    virtual void transpose(int semitones) {}
+    virtual void reset() {}
+    virtual void saveLoopStart() {}
+    virtual void restoreLoopStart() {}
+    virtual void drawScrollingSymbols(bool show = true) {}
+    virtual void scrollDeltaTime(int ticks) {}
+    virtual void setPlayedNoteColour(int note, CColour colour, int wantedDelta, int pianistTimming = NOT_USED) {}
+    virtual void setActiveChannel(int channel) {}
+    virtual void refreshScroll() {}
+    virtual void setDisplayHand(whichPart_t hand) {}
+
+    virtual void setRatingObject(CRating* rating) {}
+    // The piano that shows the pianist's notes, 0 if there is none
+    virtual CPianistNotes* getPianoObject() { return 0; }
+};
+
+/*!
+ * @brief   The settings that the conductor changes while the pianist plays.
+ */
+class CSettingsObserver
+{
+public:
+    virtual ~CSettingsObserver() {}
+
+    virtual void setAdvancedMode(bool value) {}
+    virtual void pianistActive() {}
+};
+
+#endif //__CONDUCTOR_OBSERVER_H__
@@ -35,7 +35,6 @@ typedef unsigned int guint;
 typedef unsigned char guint8;
 
 whichPart_t CDraw::m_displayHand;
-int CDraw::m_forceCompileRedraw;
 
 void CDraw::oneLine(float x1, float y1, float x2, float y2)
 {
@@ -71,7 +71,7 @@ public:
     {
         m_settings = settings;
         m_displayHand = PB_PART_both;
-        m_forceCompileRedraw = 1;
+        forceCompileRedraw();
         m_scrollProperties = &m_scrollPropertiesHorizontal;
         font.FaceSize(FONT_SIZE, FONT_SIZE);
     }
@@ -91,15 +91,15 @@ public:
     static void setDisplayHand(whichPart_t hand)
     {
         m_displayHand = hand;
-        m_forceCompileRedraw = 1;
+        forceCompileRedraw();
     }
     static whichPart_t getDisplayHand()    {return m_displayHand;}
     static void drColour(CColour colour) { glColor3f(colour.red, colour.green, colour.blue);}
-    static void forceCompileRedraw(int value = 1) {    m_forceCompileRedraw = value; }
+    static void forceCompileRedraw(int value = 1) { CStavePos::forceStaveRedraw(value); }
 
 protected:
     static whichPart_t m_displayHand;
-    static int getCompileRedrawCount() {  return m_forceCompileRedraw; }
+    static int getCompileRedrawCount() { return CStavePos::getStaveRedraw(); }
 
     void oneLine(float x1, float y1, float x2, float y2);
     void drawStaves(float startX, float endX);
@@ -115,7 +115,6 @@ private:
 
     void checkAccidental(CSymbol symbol, float x, float y);
     void drawStaveExtentsion(CSymbol symbol, float x, int noteWidth, bool playable);
-    static int m_forceCompileRedraw;
     const static int m_beatMarkerHeight = 10; // The height of the beat markers in the stave positions
 
     CScrollProperties *m_scrollProperties;
@@ -58,7 +58,10 @@ CGLView::CGLView(QtWindow* parent, CSettings* settings)
 
     m_song = new CSong();
     m_score = new CScore(m_settings);
+    m_trackList = new CTrackList;
+    m_song->setTrackAnalysis(m_trackList);
     m_displayUpdateTicks = 0;
+    m_lastTaskTime = ppTimeNanos();
     m_cfg_openGlOptimise = 0; // zero is no GlOptimise
     m_eventBits = 0;
     BENCHMARK_INIT();
@@ -69,6 +72,7 @@ CGLView::~CGLView()
     makeCurrent();
     delete m_song;
     delete m_score;
+    delete m_trackList;
     m_titleHeight = 0;
 
 }
@@ -357,15 +361,16 @@ void CGLView::initializeGL()
 
     m_timer.start(Cfg::tickRate, this );
 
-    m_realtime.start();
+    m_lastTaskTime = ppTimeNanos();
 
     //startMediaTimer(12, this );
 }
 
 void CGLView::updateMidiTask()
 {
-    int ticks;
-    ticks = m_realtime.restart();
+    qint64 now = ppTimeNanos();
+    qint64 ticks = now - m_lastTaskTime;
+    m_lastTaskTime = now;
     m_displayUpdateTicks += ticks;
     m_eventBits |= m_song->task(ticks);
 }
@@ -383,7 +388,7 @@ void CGLView::timerEvent(QTimerEvent *event)
     updateMidiTask();
     BENCHMARK(1, "m_song task");
 
-    if (m_displayUpdateTicks < SCREEN_FRAME_RATE)
+    if (m_displayUpdateTicks < SCREEN_FRAME_RATE * NANO_SECONDS_PER_MSEC)
         return;
 
     m_displayUpdateTicks = 0;
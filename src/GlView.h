@@ -32,6 +32,7 @@
 #include <QGLWidget>
 #include "Song.h"
 #include "Score.h"
+#include "TrackList.h"
 #include "Settings.h"
 //#include "rtmidi/RtTimer.h"
 
@@ -49,6 +50,7 @@ public:
     QSize sizeHint() const;
     CSong* getSongObject() {return m_song;}
     CScore* getScoreObject() {return m_score;}
+    CTrackList* getTrackList() {return m_trackList;}
     int m_cfg_openGlOptimise;
 
 protected:
@@ -74,9 +76,10 @@ private:
     CSettings* m_settings;
     CSong* m_song;
     CScore* m_score;
+    CTrackList* m_trackList;
     QBasicTimer m_timer;
-    QTime m_realtime;
-    int m_displayUpdateTicks;
+    qint64 m_lastTaskTime;          // ppTimeNanos() when the midi task last ran
+    qint64 m_displayUpdateTicks;    // nSec since the display was updated
     CRating* m_rating;
     QFont m_timeSigFont;
     QFont m_timeRatingFont;
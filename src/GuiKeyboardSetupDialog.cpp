@@ -30,6 +30,7 @@
 
 
 #include "GuiKeyboardSetupDialog.h"
+#include "TrackList.h"
 
 #include "rtmidi/RtMidi.h"
 
@@ -131,12 +131,32 @@ void GuiSidePanel::on_bookCombo_activated (int index)
     for (int i = 0; i < songNames.size(); ++i)
     {
         songCombo->addItem( songNames.at(i));
+        songInfo_t info;
+        if (m_settings->getSongInfo(songNames.at(i), &info) && info.trackCount > 0)
+            songCombo->setItemData(i, songToolTip(info), Qt::ToolTipRole);
         if (songNames.at(i) == currentSong)
             songCombo->setCurrentIndex(i);
     }
     on_songCombo_activated(0); // Now load the selected song
 }
 
+// Describes the song using what the song index knows about it
+QString GuiSidePanel::songToolTip(const songInfo_t& info)
+{
+    QString toolTip = info.title.isEmpty() ? info.fileName : info.title;
+    int seconds = static_cast<int>(info.duration / 1000);
+
+    toolTip += "\n" + tr("Length %1:%2").arg(seconds / 60).arg(seconds % 60, 2, 10, QChar('0'));
+    if (info.minTempo == info.maxTempo)
+        toolTip += "\n" + tr("Tempo %1 bpm").arg(info.minTempo);
+    else
+        toolTip += "\n" + tr("Tempo %1-%2 bpm").arg(info.minTempo).arg(info.maxTempo);
+    if (info.timeSigTop > 0)
+        toolTip += "\n" + tr("Time signature %1/%2").arg(info.timeSigTop).arg(info.timeSigBottom);
+    toolTip += "\n" + tr("%1 notes, %2 tracks, %3 channels").arg(info.noteCount).arg(info.trackCount).arg(info.channelCount);
+    return toolTip;
+}
+
 void GuiSidePanel::on_songCombo_activated(int index)
 {
     m_settings->setCurrentSongName(songCombo->currentText());
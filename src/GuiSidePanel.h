@@ -171,6 +171,7 @@ private slots:
 
 private:
     void autoSetMuteYourPart();
+    QString songToolTip(const songInfo_t& info);
 
     CSong* m_song;
     CScore* m_score;
@@ -40,11 +40,11 @@ GuiSongDetailsDialog::GuiSongDetailsDialog(QWidget *parent)
 }
 
 
-void GuiSongDetailsDialog::init(CSong* song, CSettings* settings)
+void GuiSongDetailsDialog::init(CSong* song, CSettings* settings, CGLView* glView)
 {
     m_song = song;
     m_settings = settings;
-    m_trackList = m_song->getTrackList();
+    m_trackList = glView->getTrackList();
     leftHandChannelCombo->addItem(tr("No channel assigned"));
     leftHandChannelCombo->addItems(m_trackList->getAllChannelProgramNames(true));
     rightHandChannelCombo->addItem(tr("No channel assigned"));
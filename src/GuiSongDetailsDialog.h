@@ -33,6 +33,7 @@
 #include <QtWidgets>
 
 #include "Song.h"
+#include "TrackList.h"
 #include "Settings.h"
 
 
@@ -46,7 +47,7 @@ class GuiSongDetailsDialog : public QDialog, private Ui::GuiSongDetailsDialog
 
 public:
     GuiSongDetailsDialog(QWidget *parent = 0);
-    void init(CSong* song, CSettings* settings);
+    void init(CSong* song, CSettings* settings, CGLView* glView);
 
 private slots:
     void accept();
@@ -26,6 +26,7 @@
 */
 /////////////////////////////////////////////////////////////////////////////
 
+#include <algorithm>
 #include "Merge.h"
 
 
@@ -34,78 +35,56 @@
 void  CMerge::initMergedEvents()
 {
     int i;
+
+    m_mergeHeap.clear();
+    m_mergeHeap.reserve(m_mergeEvents.size());
+    m_currentTime = 0;
     for( i = 0; i < m_mergeEvents.size(); i++)
     {
         m_mergeEvents[i].clear();
-        if (checkMidiEventFromStream(i) )
-            m_mergeEvents[i] = fetchMidiEventFromStream(i);
+        fetchNextEvent(i, 0);
     }
 }
 
-
-int CMerge::nextMergedEvent()
+// Fetch the next event from a stream and add it to the heap at its absolute time
+void CMerge::fetchNextEvent(int streamIdx, int streamTime)
 {
-    int nearestIndex = 0;
-	
-    int i;
-    CMidiEvent* nearestEvent;
-    int deltaTime;
+    mergeSlot_t slot;
 
-	nearestEvent = 0;
-    // find the first active slot
-    for( i = 0; i < m_mergeEvents.size(); i++)
+    if (!checkMidiEventFromStream(streamIdx))
     {
-        if (m_mergeEvents[i].type() != MIDI_NONE)
-        {
-            nearestEvent = &m_mergeEvents[i];
-            nearestIndex = i;
-            break;
-        }
+        m_mergeEvents[streamIdx].clear();
+        return;
     }
-    if (nearestEvent == 0)
-        return 0;
+    m_mergeEvents[streamIdx] = fetchMidiEventFromStream(streamIdx);
 
-    // now search the remaining active slots
-    for( i = nearestIndex + 1; i < m_mergeEvents.size(); i++)
-    {
-        if (m_mergeEvents[i].type() != MIDI_NONE)
-        {
-            // find the slot with the lowest delta time
-            if (m_mergeEvents[i].deltaTime() < nearestEvent->deltaTime())
-            {
-                nearestEvent = &m_mergeEvents[i];
-                nearestIndex = i;
-            }
-        }
-    }
-
-    deltaTime =  -nearestEvent->deltaTime();
-
-    // Now subtract the delta time from all the others
-    for( i = 0; i < m_mergeEvents.size(); i++)
-    {
-        if (i == nearestIndex)
-            continue;
-        if (m_mergeEvents[i].type() != MIDI_NONE)
-            m_mergeEvents[i].addDeltaTime( deltaTime );
-    }
-  
-    return nearestIndex;
+    slot.time = streamTime + m_mergeEvents[streamIdx].deltaTime();
+    slot.streamIdx = streamIdx;
+    m_mergeHeap.push_back(slot);
+    std::push_heap(m_mergeHeap.begin(), m_mergeHeap.end(), laterSlot);
 }
 
 
 CMidiEvent CMerge::readMidiEvent()
 {
-    int mergeIdx;
+    mergeSlot_t slot;
     CMidiEvent event;
 
-    mergeIdx = nextMergedEvent();
-    event = m_mergeEvents[mergeIdx];
-
-    m_mergeEvents[mergeIdx].clear();
-	if (checkMidiEventFromStream(mergeIdx) )
-		m_mergeEvents[mergeIdx] = fetchMidiEventFromStream(mergeIdx);
-    if (event.type() == MIDI_NONE)
+    if (m_mergeHeap.empty())
+    {
         event.setType(MIDI_PB_EOF);
+        return event;
+    }
+
+    std::pop_heap(m_mergeHeap.begin(), m_mergeHeap.end(), laterSlot);
+    slot = m_mergeHeap.back();
+    m_mergeHeap.pop_back();
+
+    event = m_mergeEvents[slot.streamIdx];
+    // convert back to the time since the previous merged event
+    event.setDeltaTime(slot.time - m_currentTime);
+    m_currentTime = slot.time;
+
+    fetchNextEvent(slot.streamIdx, slot.time);
     return event;
 }
@@ -30,14 +30,17 @@
 #define __MERGE_H__
 
 #include <QVector>
+#include <vector>
 #include "MidiEvent.h"
 
-// Reads data from a standard MIDI file
+// Merges the streams by always taking the stream with the earliest absolute time next.
+// The streams waiting to be merged are kept in a heap so each event costs O(log streams).
 class CMerge
 {
 public:
     CMerge()
     {
+        m_currentTime = 0;
     }
 	CMidiEvent readMidiEvent();
 	    //you should always have a virtual destructor when using virtual functions
@@ -46,12 +49,29 @@ public:
 protected:
 	void setSize(int size) {m_mergeEvents.resize(size);}
     void initMergedEvents();
-    int nextMergedEvent();
 	virtual bool checkMidiEventFromStream(int streamIdx) = 0;
 	virtual CMidiEvent fetchMidiEventFromStream(int streamIdx)  = 0;
 
 private:
-    QVector<CMidiEvent> m_mergeEvents;
+    typedef struct
+    {
+        int time;       // The absolute time of the waiting event in ticks
+        int streamIdx;
+    } mergeSlot_t;
+
+    // The heap order, the earliest time comes first and the lowest stream index wins a tie
+    static bool laterSlot(const mergeSlot_t& a, const mergeSlot_t& b)
+    {
+        if (a.time != b.time)
+            return a.time > b.time;
+        return a.streamIdx > b.streamIdx;
+    }
+
+    void fetchNextEvent(int streamIdx, int streamTime);
+
+    QVector<CMidiEvent> m_mergeEvents;  // The next event waiting in each stream
+    std::vector<mergeSlot_t> m_mergeHeap;
+    int m_currentTime;                  // The absolute time of the last merged event
 };
 
 #endif // __MERGE_H__
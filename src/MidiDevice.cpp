@@ -28,6 +28,7 @@
 
 #include "MidiDevice.h"
 #include "MidiDeviceRt.h"
+#include "MidiDeviceVirtual.h"
 #if PB_USE_FLUIDSYNTH
     #include "MidiDeviceFluidSynth.h"
 #endif
@@ -44,10 +45,16 @@ CMidiDevice::CMidiDevice()
     m_selectedMidiInputDevice = m_rtMidiDevice;
     m_selectedMidiOutputDevice = m_rtMidiDevice;
     m_validOutput = false;
+    m_scheduler = 0;
+    m_virtualDevice = 0;
+    m_savedMidiInputDevice = 0;
+    m_savedMidiOutputDevice = 0;
+    m_savedValidOutput = false;
 }
 
 CMidiDevice::~CMidiDevice()
 {
+    delete m_scheduler; // Stop sending the scheduled events before the devices go
     delete m_rtMidiDevice;
 #if PB_USE_FLUIDSYNTH
     delete m_fluidSynthMidiDevice;
@@ -79,6 +86,7 @@ bool CMidiDevice::openMidiPort(midiType_t type, QString portName)
     {
         if (m_rtMidiDevice->openMidiPort(type, portName))
         {
+            QMutexLocker locker(&m_outputMutex);
             m_selectedMidiOutputDevice = m_rtMidiDevice;
             return true;
         }
@@ -90,6 +98,7 @@ bool CMidiDevice::openMidiPort(midiType_t type, QString portName)
         //m_selectedMidiOutputDevice->closeMidiPort(type, portName);
         if ( m_rtMidiDevice->openMidiPort(type, portName) )
         {
+            QMutexLocker locker(&m_outputMutex);
             m_selectedMidiOutputDevice = m_rtMidiDevice;
             m_validOutput = true;
             return true;
@@ -97,6 +106,7 @@ bool CMidiDevice::openMidiPort(midiType_t type, QString portName)
 #if PB_USE_FLUIDSYNTH
         if ( m_fluidSynthMidiDevice->openMidiPort(type, portName) )
         {
+            QMutexLocker locker(&m_outputMutex);
             m_selectedMidiOutputDevice = m_fluidSynthMidiDevice;
             m_validOutput = true;
             return true;
@@ -108,6 +118,8 @@ bool CMidiDevice::openMidiPort(midiType_t type, QString portName)
 
 void CMidiDevice::closeMidiPort(midiType_t type, int index)
 {
+    flushScheduledMidiEvents();
+    QMutexLocker locker(&m_outputMutex);
     if (m_selectedMidiOutputDevice == 0)
         return;
 
@@ -119,6 +131,7 @@ void CMidiDevice::closeMidiPort(midiType_t type, int index)
 //! add a midi event to be played immediately
 void CMidiDevice::playMidiEvent(const CMidiEvent & event)
 {
+    QMutexLocker locker(&m_outputMutex);
     if (m_selectedMidiOutputDevice == 0)
         return;
 
@@ -126,6 +139,61 @@ void CMidiDevice::playMidiEvent(const CMidiEvent & event)
     //event.printDetails(); // useful for debugging
 }
 
+void CMidiDevice::scheduleMidiEvent(const CMidiEvent & event, qint64 time)
+{
+    // The virtual device keeps the time with the event, there is nothing to wait for
+    if (m_virtualDevice != 0)
+    {
+        m_virtualDevice->scheduleMidiEvent(event, time);
+        return;
+    }
+    if (m_scheduler == 0)
+        m_scheduler = new CMidiScheduler(this);
+    m_scheduler->scheduleEvent(event, time);
+}
+
+void CMidiDevice::flushScheduledMidiEvents()
+{
+    if (m_scheduler != 0)
+        m_scheduler->flush();
+    if (m_virtualDevice != 0)
+        m_virtualDevice->flush();
+}
+
+void CMidiDevice::setVirtualDevice(CMidiDeviceVirtual* device)
+{
+    if (device == m_virtualDevice)
+        return;
+    flushScheduledMidiEvents();
+    QMutexLocker locker(&m_outputMutex);
+    if (m_virtualDevice == 0)
+    {
+        m_savedMidiInputDevice = m_selectedMidiInputDevice;
+        m_savedMidiOutputDevice = m_selectedMidiOutputDevice;
+        m_savedValidOutput = m_validOutput;
+    }
+    m_virtualDevice = device;
+    if (device != 0)
+    {
+        m_selectedMidiInputDevice = device;
+        m_selectedMidiOutputDevice = device;
+        m_validOutput = true;
+    }
+    else
+    {
+        m_selectedMidiInputDevice = m_savedMidiInputDevice;
+        m_selectedMidiOutputDevice = m_savedMidiOutputDevice;
+        m_validOutput = m_savedValidOutput;
+    }
+}
+
+qint64 CMidiDevice::getTimeMicros()
+{
+    if (m_virtualDevice != 0)
+        return m_virtualDevice->getTime();
+    return ppTimeMicros();
+}
+
 
 // Return the number of events waiting to be read from the midi device
 int CMidiDevice::checkMidiInput()
@@ -142,6 +210,11 @@ CMidiEvent CMidiDevice::readMidiInput()
     return m_selectedMidiInputDevice->readMidiInput();
 }
 
+qint64 CMidiDevice::getMidiInputTime()
+{
+    return m_selectedMidiInputDevice->getMidiInputTime();
+}
+
 
 int CMidiDevice::midiSettingsSetStr(QString name, QString str)
 {
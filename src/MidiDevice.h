@@ -35,9 +35,13 @@
  */
 
 
+#include <QMutex>
 #include "MidiEvent.h"
 
 #include "MidiDeviceBase.h"
+#include "MidiScheduler.h"
+
+class CMidiDeviceVirtual;
 
 class CMidiDevice : public CMidiDeviceBase
 {
@@ -47,8 +51,18 @@ public:
     void init();
     //! add a midi event to be played immediately
     void playMidiEvent(const CMidiEvent & event);
+    //! add a midi event to be played at a time (see ppTimeMicros()) a little in the future
+    void scheduleMidiEvent(const CMidiEvent & event, qint64 time);
+    //! throw away the midi events that are scheduled but have not yet been played
+    void flushScheduledMidiEvents();
+    //! use a virtual device (and its clock) for both the input and output, 0 goes back to the real ports
+    void setVirtualDevice(CMidiDeviceVirtual* device);
+    CMidiDeviceVirtual* getVirtualDevice() { return m_virtualDevice; }
+    //! the time now in microseconds, from the virtual device if there is one otherwise from ppTimeMicros()
+    qint64 getTimeMicros();
     int checkMidiInput();
     CMidiEvent readMidiInput();
+    qint64 getMidiInputTime();
     bool validMidiOutput() { return m_validOutput; }
 
     QStringList getMidiPortList(midiType_t type);
@@ -71,6 +85,12 @@ private:
     CMidiDeviceBase* m_selectedMidiInputDevice;
     CMidiDeviceBase* m_selectedMidiOutputDevice;
     bool m_validOutput;
+    CMidiScheduler* m_scheduler;    // Only started once an event is scheduled
+    CMidiDeviceVirtual* m_virtualDevice;
+    CMidiDeviceBase* m_savedMidiInputDevice;   // The real devices while the virtual one is used
+    CMidiDeviceBase* m_savedMidiOutputDevice;
+    bool m_savedValidOutput;
+    QMutex m_outputMutex;           // The scheduler also plays the events, so guard the output device
 };
 
 #endif //__MIDI_DEVICE_H__
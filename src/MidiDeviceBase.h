@@ -48,6 +48,8 @@ public:
     virtual void playMidiEvent(const CMidiEvent & event) = 0;
     virtual int checkMidiInput() = 0;
     virtual CMidiEvent readMidiInput() = 0;
+    // When the last event returned by readMidiInput() arrived (see ppTimeMicros()), -1 if not known
+    virtual qint64 getMidiInputTime() { return -1; }
 
     typedef enum {MIDI_INPUT, MIDI_OUTPUT} midiType_t;
     virtual QStringList getMidiPortList(midiType_t type) = 0;
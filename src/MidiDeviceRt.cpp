@@ -36,12 +36,36 @@ CMidiDeviceRt::CMidiDeviceRt()
     m_midiPorts[0] = -1;
     m_midiPorts[1] = -1;
     m_rawDataIndex = 0;
+    m_inputTime = -1;
+    m_inputQueue = new CQueue<midiInputMessage_t>(1024);
+    // The messages are passed to us as they arrive instead of waiting in RtMidi's own (small) queue
+    m_midiin->setCallback(&CMidiDeviceRt::midiInputCallback, this);
 }
 
 CMidiDeviceRt::~CMidiDeviceRt()
 {
     delete m_midiout;
-    delete m_midiin;
+    delete m_midiin; // This stops the RtMidi input thread
+    delete m_inputQueue;
+}
+
+void CMidiDeviceRt::midiInputCallback(double /*deltaTime*/, std::vector<unsigned char>* message, void* userData)
+{
+    CMidiDeviceRt* device = static_cast<CMidiDeviceRt*>(userData);
+    midiInputMessage_t input;
+
+    // Only the channel messages are used (sysex, timing and active sensing are ignored by RtMidi)
+    if (message->size() == 0 || message->size() > arraySize(input.data))
+        return;
+    input.time = ppTimeMicros();
+    input.length = static_cast<int>(message->size());
+    for (int i = 0; i < static_cast<int>(arraySize(input.data)); i++)
+        input.data[i] = (i < input.length) ? (*message)[i] : 0;
+
+    if (device->m_inputQueue->space() > 0)
+        device->m_inputQueue->push(input);
+    else
+        device->m_inputOverflow.storeRelease(1);
 }
 
 void CMidiDeviceRt::init()
@@ -213,8 +237,12 @@ int CMidiDeviceRt::checkMidiInput()
 {
     if (m_midiPorts[0] < 0)
         return 0;
-    m_midiin->getMessage( &m_inputMessage );
-    return m_inputMessage.size();
+    if (m_inputOverflow.loadAcquire())
+    {
+        m_inputOverflow.storeRelease(0);
+        ppLogWarn("Midi input queue full, some notes were lost");
+    }
+    return m_inputQueue->length();
 }
 
 // reads the real midi event
@@ -223,6 +251,9 @@ CMidiEvent CMidiDeviceRt::readMidiInput()
     CMidiEvent midiEvent;
     unsigned int channel;
 
+    midiInputMessage_t input = m_inputQueue->pop();
+    m_inputMessage.assign(input.data, input.data + input.length);
+    m_inputTime = input.time;
 
     if (Cfg::midiInputDump)
     {
@@ -30,10 +30,20 @@
 #define __MIDI_DEVICE_RT_H__
 
 
+#include <QAtomicInt>
 #include "MidiDeviceBase.h"
+#include "Queue.h"
 
 #include "rtmidi/RtMidi.h"
 
+// A midi message from the keyboard and when it arrived
+typedef struct
+{
+    unsigned char data[3];
+    int length;
+    qint64 time;        // ppTimeMicros() when RtMidi passed it to us
+} midiInputMessage_t;
+
 
 class CMidiDeviceRt : public CMidiDeviceBase
 {
@@ -42,6 +52,7 @@ class CMidiDeviceRt : public CMidiDeviceBase
     virtual void playMidiEvent(const CMidiEvent & event);
     virtual int checkMidiInput();
     virtual CMidiEvent readMidiInput();
+    virtual qint64 getMidiInputTime() { return m_inputTime; }
 
     virtual QStringList getMidiPortList(midiType_t type);
 
@@ -62,6 +73,8 @@ public:
 
 
 private:
+    // Called by RtMidi on its own thread as soon as a message arrives
+    static void midiInputCallback(double deltaTime, std::vector<unsigned char>* message, void* userData);
 
     RtMidiOut *m_midiout;
     RtMidiIn *m_midiin;
@@ -69,6 +82,9 @@ private:
     // 0 for input, 1 for output
     int m_midiPorts[2];      // select which MIDI output port to open
     std::vector<unsigned char> m_inputMessage;
+    CQueue<midiInputMessage_t>* m_inputQueue; // Pushed by the RtMidi thread, popped by the engine
+    qint64 m_inputTime;                      // When m_inputMessage arrived
+    QAtomicInt m_inputOverflow;              // Set by the RtMidi thread if the queue was full
     unsigned char m_savedRawBytes[40]; // Raw data is used for used for a SYSTEM_EVENT
     unsigned int m_rawDataIndex;
 
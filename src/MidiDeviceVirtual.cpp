@@ -0,0 +1,106 @@
+/*********************************************************************************/
+/*!
+@file           MidiDeviceVirtual.cpp
+
+@brief          A midi device with a virtual clock, for running the engine without a real port.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include "MidiDeviceVirtual.h"
+
+void CMidiDeviceVirtual::clear()
+{
+    m_timeNanos = 0;
+    m_input.clear();
+    m_inputTime = -1;
+    m_scheduled.clear();
+    m_output.clear();
+}
+
+void CMidiDeviceVirtual::setTimeNanos(qint64 time)
+{
+    m_timeNanos = time;
+    qint64 now = getTime();
+    while (!m_scheduled.empty() && m_scheduled.front().time <= now)
+    {
+        m_output.push_back(m_scheduled.front());
+        m_scheduled.pop_front();
+    }
+}
+
+void CMidiDeviceVirtual::addInputEvent(qint64 time, const CMidiEvent& event)
+{
+    scheduledMidiEvent_t input;
+    input.time = time;
+    input.event = event;
+
+    // Notes at the same time are read in the order they were added
+    deque<scheduledMidiEvent_t>::iterator it = m_input.end();
+    while (it != m_input.begin() && (it - 1)->time > time)
+        --it;
+    m_input.insert(it, input);
+}
+
+void CMidiDeviceVirtual::scheduleMidiEvent(const CMidiEvent & event, qint64 time)
+{
+    scheduledMidiEvent_t output;
+    output.time = time;
+    output.event = event;
+    // The events still waiting are all later than now
+    if (time <= getTime())
+    {
+        m_output.push_back(output);
+        return;
+    }
+
+    // Events at the same time are played in the order they were scheduled
+    deque<scheduledMidiEvent_t>::iterator it = m_scheduled.end();
+    while (it != m_scheduled.begin() && (it - 1)->time > time)
+        --it;
+    m_scheduled.insert(it, output);
+}
+
+void CMidiDeviceVirtual::playMidiEvent(const CMidiEvent & event)
+{
+    scheduledMidiEvent_t output;
+    output.time = getTime();
+    output.event = event;
+    m_output.push_back(output);
+}
+
+int CMidiDeviceVirtual::checkMidiInput()
+{
+    int count = 0;
+    qint64 now = getTime();
+    while (count < static_cast<int>(m_input.size()) && m_input[count].time <= now)
+        count++;
+    return count;
+}
+
+CMidiEvent CMidiDeviceVirtual::readMidiInput()
+{
+    CMidiEvent event = m_input.front().event;
+    m_inputTime = m_input.front().time;
+    m_input.pop_front();
+    return event;
+}
@@ -0,0 +1,99 @@
+/*********************************************************************************/
+/*!
+@file           MidiDeviceVirtual.h
+
+@brief          A midi device with a virtual clock, for running the engine without a real port.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __MIDI_DEVICE_VIRTUAL_H__
+#define __MIDI_DEVICE_VIRTUAL_H__
+
+#include <deque>
+#include <vector>
+#include "MidiDeviceBase.h"
+#include "MidiScheduler.h"
+
+using namespace std;
+
+/*!
+ * @brief   A midi device that plays a script of pianist notes and keeps every event sent to it.
+ *
+ * Nothing here waits for the real time. The owner moves the virtual clock on, the input events
+ * become readable once the clock reaches them, and the output events are kept with the time they
+ * were played (or scheduled for). A scheduled event waits, like it would in CMidiScheduler, until the
+ * clock reaches it. So the same script always gives exactly the same output.
+ */
+class CMidiDeviceVirtual : public CMidiDeviceBase
+{
+public:
+    CMidiDeviceVirtual() { clear(); }
+
+    // Throw away the script and the output, and put the clock back to 0
+    void clear();
+
+    // The virtual clock, in nanoseconds, the scheduled events that are now due are played
+    void setTimeNanos(qint64 time);
+    qint64 getTimeNanos() { return m_timeNanos; }
+    // The clock in microseconds, on the same scale as ppTimeMicros()
+    qint64 getTime() { return m_timeNanos / 1000; }
+
+    // Add a pianist's note to the script, the time is in microseconds
+    void addInputEvent(qint64 time, const CMidiEvent& event);
+    int getInputEventsLeft() { return static_cast<int>(m_input.size()); }
+
+    // Every event played, in the order they were played, with the time they are to sound
+    const vector<scheduledMidiEvent_t>& getOutput() { return m_output; }
+    void clearOutput() { m_output.clear(); }
+
+    // Play the event at the time instead of now
+    void scheduleMidiEvent(const CMidiEvent & event, qint64 time);
+    // Throw away the scheduled events the clock has not yet reached
+    void flush() { m_scheduled.clear(); }
+
+    virtual void init() {}
+    virtual void playMidiEvent(const CMidiEvent & event);
+    virtual int checkMidiInput();
+    virtual CMidiEvent readMidiInput();
+    virtual qint64 getMidiInputTime() { return m_inputTime; }
+
+    virtual QStringList getMidiPortList(midiType_t) { return QStringList(); }
+    virtual bool openMidiPort(midiType_t, QString) { return true; }
+    virtual void closeMidiPort(midiType_t, int) {}
+
+    virtual int     midiSettingsSetStr(QString, QString) { return 0; }
+    virtual int     midiSettingsSetNum(QString, double) { return 0; }
+    virtual int     midiSettingsSetInt(QString, int) { return 0; }
+    virtual QString midiSettingsGetStr(QString) { return QString(); }
+    virtual double  midiSettingsGetNum(QString) { return 0.0; }
+    virtual int     midiSettingsGetInt(QString) { return 0; }
+
+private:
+    qint64 m_timeNanos;
+    deque<scheduledMidiEvent_t> m_input;    // The script, in time order
+    qint64 m_inputTime;                     // When the last event read was played
+    deque<scheduledMidiEvent_t> m_scheduled;  // Waiting for the clock, in time order
+    vector<scheduledMidiEvent_t> m_output;
+};
+
+#endif // __MIDI_DEVICE_VIRTUAL_H__
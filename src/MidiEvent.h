@@ -57,6 +57,8 @@
 #define MIDI_PB_collateRawMidiData  0x0ff7
 #define MIDI_PB_outputRawMidiData   0x0ff8  // Raw data is used for used for a SYSTEM_EVENT
 
+#define NO_KEY_SIGNATURE    0x7fffffff  // A song or track without a key signature
+
 /*===================================*/
 /*                                   */
 /* Standard MIDI file events         */
@@ -86,7 +88,11 @@
 
 
 /*!
- * @brief   xxxxx.
+ * @brief   A single midi event packed into 12 bytes.
+ *
+ * The events are copied by value through all the queues so they are kept small.
+ * The type, channel, note and velocity share one 32 bit word and
+ * the tempo (which is too big for the note) is kept in the duration.
  */
 class CMidiEvent
 {
@@ -99,7 +105,7 @@ public:
 
     void clear()
     {
-        m_type = MIDI_NONE;
+        setType(MIDI_NONE);
         m_deltaTime = 0;
         m_channel = 0;
         m_note = 0;
@@ -116,12 +122,13 @@ public:
     int note() const {return m_note;}
     void setNote(int note){m_note = note;}
     int programme() const {return m_note;}
-    int channel() const {return m_channel;} // can also contain the track number
+    int channel() const {return m_channel;}
     void setChannel(int chan){m_channel = chan;}
     int velocity() const {return m_velocity;}
     void setVelocity(int value) {m_velocity = value;}
-    int type() const {return m_type;}
-    void setType(int type){m_type = type;}
+    int type() const {return (m_type & 0x10) ? (MIDI_NONE | (m_type & 0x0f)) : (m_type << 4);}
+    // The midi types (0x80 - 0xF0) are stored as 0x08 - 0x0F and our own types (0x0ff0 - 0x0fff) as 0x10 - 0x1F
+    void setType(int type){m_type = (type & 0xff00) ? (0x10 | (type & 0x0f)) : ((type >> 4) & 0x0f);}
     void transpose(int amount) {m_note += amount;}
     int data1() const {return m_note;} // Meta data is stored here
     int data2() const {return m_velocity;}
@@ -129,7 +136,7 @@ public:
 
     void noteOffEvent( int deltaTime, int channel, int note, int velocity)
     {
-        m_type = MIDI_NOTE_OFF;
+        setType(MIDI_NOTE_OFF);
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = note;
@@ -138,7 +145,7 @@ public:
 
     void noteOnEvent( int deltaTime, int channel, int note, int velocity)
     {
-        m_type = MIDI_NOTE_ON;
+        setType(MIDI_NOTE_ON);
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = note;
@@ -147,7 +154,7 @@ public:
 
     void notePressure( int deltaTime, int channel, int data1, int data2)
     {
-        m_type = MIDI_NOTE_PRESSURE; //POLY_AFTERTOUCH: 3 bytes
+        setType(MIDI_NOTE_PRESSURE); //POLY_AFTERTOUCH: 3 bytes
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = data1;
@@ -156,7 +163,7 @@ public:
 
     void programChangeEvent( int deltaTime, int channel, int program)
     {
-        m_type = MIDI_PROGRAM_CHANGE;
+        setType(MIDI_PROGRAM_CHANGE);
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = program;
@@ -165,7 +172,7 @@ public:
 
     void controlChangeEvent( int deltaTime, int channel, int data1, int data2)
     {
-        m_type = MIDI_CONTROL_CHANGE;
+        setType(MIDI_CONTROL_CHANGE);
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = data1;
@@ -174,7 +181,7 @@ public:
 
     void channelPressure( int deltaTime, int channel, int data1)
     {
-        m_type = MIDI_CHANNEL_PRESSURE; //AFTERTOUCH: 2 bytes
+        setType(MIDI_CHANNEL_PRESSURE); //AFTERTOUCH: 2 bytes
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = data1;
@@ -183,7 +190,7 @@ public:
 
     void pitchBendEvent( int deltaTime, int channel, int data1, int data2)
     {
-        m_type = MIDI_PITCH_BEND;
+        setType(MIDI_PITCH_BEND);
         m_deltaTime = deltaTime;
         m_channel = channel;
         m_note = data1;
@@ -192,7 +199,7 @@ public:
 
     void chordSeparator(CMidiEvent &event)
     {
-        m_type = MIDI_PB_chordSeparator;
+        setType(MIDI_PB_chordSeparator);
         m_note = 0;
         m_channel = event.channel();
         m_deltaTime = 0;
@@ -201,17 +208,29 @@ public:
 
     void metaEvent( int deltaTime, int type, int data1, int data2)
     {
-        m_type = type;
+        setType(type);
         m_deltaTime = deltaTime;
         m_channel = 0;
         m_note = data1;
         m_velocity = data2;
     }
 
+    // The tempo is in micro seconds per quarter note and needs 24 bits
+    void tempoEvent( int deltaTime, int tempo)
+    {
+        setType(MIDI_PB_tempo);
+        m_deltaTime = deltaTime;
+        m_channel = 0;
+        m_note = 0;
+        m_velocity = 0;
+        m_duration = tempo;
+    }
+    int tempo() const {return m_duration;}
+
     // Raw data is used for used for a SYSTEM_EVENT
     void collateRawByte( int deltaTime, int nextByte)
     {
-        m_type = MIDI_PB_collateRawMidiData;
+        setType(MIDI_PB_collateRawMidiData);
         m_deltaTime = deltaTime;
         m_note = nextByte;
         m_velocity = 0;
@@ -220,7 +239,7 @@ public:
     // Raw data is used for used for a SYSTEM_EVENT
     void outputCollatedRawBytes(int deltaTime)
     {
-        m_type = MIDI_PB_outputRawMidiData;
+        setType(MIDI_PB_outputRawMidiData);
         m_deltaTime = deltaTime;
         m_note = 0;
         m_velocity = 0;
@@ -249,12 +268,12 @@ public:
    }
 
 private:
-    int m_type;
     int m_deltaTime;
-    int m_channel;
-    int m_note;
-    int m_velocity;
-    int m_duration;
+    int m_duration;         // Also holds the tempo for a MIDI_PB_tempo event
+    unsigned int m_type:5;  // See setType()
+    signed int m_channel:7; // -1 .. 63, only a midi channel is kept here, the file's track number never is
+    signed int m_note:10;   // The note or data1, the key signature can be negative and raw bytes go up to 255
+    signed int m_velocity:10; // The velocity or data2
 };
 
 
@@ -20,11 +20,31 @@
 */
 #include <stdio.h>
 #include <stdlib.h>
-#include <QMessageBox>
+#include <fstream>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
 
 #include "MidiFile.h"
 
-int CMidiFile::m_ppqn = DEFAULT_PPQN;
+thread_local int CMidiFile::m_ppqn = DEFAULT_PPQN;
+
+// Decodes one track on a worker thread, the tracks do not share any data so they can all run at once
+class CDecodeTrackTask : public QRunnable
+{
+public:
+    CDecodeTrackTask(CMidiTrack* track, QSemaphore* tracksDecoded) : m_track(track), m_tracksDecoded(tracksDecoded) {}
+
+    void run()
+    {
+        m_track->decodeTrack();
+        m_tracksDecoded->release();
+    }
+
+private:
+    CMidiTrack* m_track;
+    QSemaphore* m_tracksDecoded;
+};
 
 
 /* Read 16 bits from the Standard MIDI file */
@@ -32,8 +52,8 @@ int CMidiFile::readWord(void)
 {
     int value;
 
-    value  = (m_file.get()&0x0ff) <<8 ;
-    value |= m_file.get()&0x0ff;
+    value  = (readByte()&0x0ff) <<8 ;
+    value |= readByte()&0x0ff;
     return value;
 }
 
@@ -44,7 +64,7 @@ int CMidiFile::readHeader(void)
 
     for ( i=0; i < 4; i++)
     {
-        c = m_file.get();
+        c = readByte();
         if (c !="MThd"[i] )
         {
             midiError(SMF_CORRUPTED_MIDI_FILE);
@@ -82,86 +102,323 @@ int CMidiFile::readHeader(void)
 
 void CMidiFile::openMidiFile(string filename)
 {
+    QString cacheName = QString::fromLocal8Bit(filename.c_str());
+
+    // A streamed song still has its tracks reading from the file
+    deleteTracks();
     if (m_file.is_open())
         m_file.close();
-    m_file.clear();  // clear any errors
 
-    m_file.open(filename.c_str(), ios_base::in | ios_base::binary);
-    if (m_file.fail() == true)
+    m_fileData.clear();
+    m_filePos = 0;
+    m_songEvents.clear();
+    m_songEventData = 0;
+    m_songEventCount = 0;
+    m_songText.clear();
+    // A song in the music zip file is inflated into memory, so it is never streamed or cached
+    QString zipFileName;
+    bool inArchive = CMusicArchive::splitPath(cacheName, &zipFileName, 0);
+    m_streaming = (m_streamingHorizon > 0 && inArchive == false);
+
+    // A valid song cache means the midi file does not need decoding at all
+    if (m_streaming == false && inArchive == false && m_songCache.load(cacheName))
     {
-        QMessageBox::warning(0, QMessageBox::tr("Midi File Error"),
-                 QMessageBox::tr("Cannot open \"") + QString(filename.c_str()) + "\"");
-        midiError(SMF_CANNOT_OPEN_FILE);
+        midiError(SMF_NO_ERROR);
+        m_ppqn = m_songCache.getPulsesPerQuarterNote();
+        m_songTitle = m_songCache.getSongTitle();
+        m_keySig = m_songCache.getKeySignature();
+        m_majorKey = m_songCache.getMajorKey();
+        m_songEventData = m_songCache.getEvents();
+        m_songEventCount = m_songCache.getEventCount();
+        m_songText.assign(m_songCache.getTextEntries(), m_songCache.getTextEntryCount(),
+                          m_songCache.getTextData(), m_songCache.getTextLength());
+        for (size_t i = 0; i < m_songEventCount; i++)
+            analyseEvent(m_songEventData[i]);
+        rewind();
         return;
     }
-    rewind();
+
+    if (inArchive)
+    {
+        // Keep the zip file open, the next song is most likely from the same zip
+        if (zipFileName != m_musicArchive.fileName())
+            m_musicArchive.open(zipFileName);
+        if (!m_musicArchive.readFile(cacheName, m_fileData))
+        {
+            ppLogError("Cannot open %s", filename.c_str());
+            midiError(SMF_CANNOT_OPEN_FILE);
+            return;
+        }
+        m_fileLength = m_fileData.size();
+    }
+    else
+    {
+        m_file.open(filename.c_str(), ios_base::in | ios_base::binary);
+        if (m_file.fail() == true)
+        {
+            ppLogError("Cannot open %s", filename.c_str());
+            midiError(SMF_CANNOT_OPEN_FILE);
+            return;
+        }
+        // Read the whole file in one go, the tracks are then decoded straight from memory
+        m_file.seekg (0, ios::end);
+        streamoff fileLength = m_file.tellg();
+        m_file.seekg (0, ios::beg);
+        m_fileLength = (fileLength > 0) ? static_cast<size_t>(fileLength) : 0;
+
+        // A streamed song only needs the header, the tracks read the rest of the file themselves
+        if (m_streaming && fileLength > MIDI_HEADER_LENGTH)
+            fileLength = MIDI_HEADER_LENGTH;
+        if (fileLength > 0)
+        {
+            m_fileData.resize(static_cast<size_t>(fileLength));
+            m_file.read(reinterpret_cast<char*>(&m_fileData[0]), fileLength);
+            m_fileData.resize(static_cast<size_t>(m_file.gcount()));
+        }
+        if (m_streaming == false)
+        {
+            m_fileLength = m_fileData.size();
+            m_file.close();
+        }
+    }
+
+    decodeMidiFile();
+    if (m_streaming)
+    {
+        // Read through the song once for the analyser and to find any bad tracks, and then start again
+        CMidiEvent event;
+        do
+        {
+            event = readMidiEvent();
+            analyseEvent(event);
+        }
+        while (event.type() != MIDI_PB_EOF);
+        finishStreamingPass();
+        rewind();
+    }
+    else
+    {
+        if (m_songEvents.size() > 0)
+            m_songEventData = &m_songEvents[0];
+        m_songEventCount = m_songEvents.size();
+        rewind();
+        if (getMidiError() == SMF_NO_ERROR && inArchive == false)
+            m_songCache.saveInBackground(cacheName, m_songEvents, m_ppqn, m_songTitle, m_keySig, m_majorKey, m_songText);
+    }
     if (getMidiError() != SMF_NO_ERROR)
-        QMessageBox::warning(0, QMessageBox::tr("Midi File Error"),
-                 QMessageBox::tr("Midi file\"") + QString(filename.c_str()) + QMessageBox::tr("\" is corrupted"));
+        ppLogError("Midi file %s is corrupted", filename.c_str());
 }
 
-void CMidiFile::rewind()
+void CMidiFile::deleteTracks()
 {
-    size_t ntrks;
     size_t trk;
-    dword_t trackLength;
-    streampos filePos;
 
-    midiError(SMF_NO_ERROR);
-    m_ppqn = DEFAULT_PPQN;
+    for (trk = 0; trk < m_tracks.size(); trk++)
+        delete (m_tracks[trk]);
+    m_tracks.clear();
+}
 
-    m_file.seekg (0, ios::beg);
+// Put the text of the tracks together, this is done once the tracks have been read to the end
+void CMidiFile::collectSongText(size_t trackCount)
+{
+    size_t trk;
 
-    ntrks = readHeader();
-    if (ntrks == 0)
+    m_songText.clear();
+    for (trk = 0; trk < trackCount && trk < m_tracks.size(); trk++)
+        m_songText.append(m_tracks[trk]->getSongText());
+    m_songText.buildIndex();
+}
+
+void CMidiFile::findKeySignature()
+{
+    size_t trk;
+
+    for (trk = 0; trk < m_tracks.size(); trk++)
     {
-        midiError(SMF_CORRUPTED_MIDI_FILE);
-        ppLogError("Zero tracks in SMF file");
-        return;
+        if (m_tracks[trk]->getKeySignature() != NO_KEY_SIGNATURE)
+        {
+            m_keySig = m_tracks[trk]->getKeySignature();
+            m_majorKey = m_tracks[trk]->getMajorKey();
+            return;
+        }
     }
-    if (ntrks > arraySize(m_tracks))
+}
+
+// Decode the tracks in parallel using the Qt global thread pool
+void CMidiFile::decodeTracks(size_t tracksFound)
+{
+    size_t trk;
+
+    if (tracksFound == 1 || !m_parallelDecode)
     {
-        midiError(SMF_ERROR_TOO_MANY_TRACK);
-        ppLogError("Too many tracks in SMF file");
+        for (trk = 0; trk < tracksFound; trk++)
+            m_tracks[trk]->decodeTrack();
         return;
     }
-    for (trk = 0; trk < arraySize(m_tracks); trk++)
+
+    QSemaphore tracksDecoded;
+    for (trk = 0; trk < tracksFound; trk++)
+        QThreadPool::globalInstance()->start(new CDecodeTrackTask(m_tracks[trk], &tracksDecoded));
+
+    // wait for all the tracks to finish before merging them
+    tracksDecoded.acquire(static_cast<int>(tracksFound));
+}
+
+// Create the tracks from the track headers, stops at the first bad header
+size_t CMidiFile::createTracks()
+{
+    size_t trk;
+    size_t filePos;
+
+    deleteTracks();
+    m_tracks.reserve(m_trackCount);
+
+    filePos = m_tracksStart;
+    for (trk = 0; trk < m_trackCount; trk++)
+    {
+        if (filePos > m_fileLength)
+            filePos = m_fileLength;
+        if (m_streaming)
+            m_tracks.push_back(new CMidiTrack(&m_file, filePos, m_fileLength, trk));
+        else
+            m_tracks.push_back(new CMidiTrack(&m_fileData[0] + filePos, m_fileLength - filePos, trk));
+        if (m_tracks[trk]->failed())
+            break;
+        //now move onto the next track
+        filePos += m_tracks[trk]->getTrackLength();
+    }
+    return m_tracks.size();
+}
+
+// Only use the tracks up to and including the first bad track
+void CMidiFile::checkTracks()
+{
+    size_t trk;
+
+    for (trk = 0; trk < m_tracks.size(); trk++)
     {
-        if (m_tracks[trk]!= 0)
+        if (m_tracks[trk]->failed())
         {
-            delete (m_tracks[trk]);
-            m_tracks[trk] = 0;
+            midiError(m_tracks[trk]->getMidiError());
+
+            for (size_t i = trk + 1; i < m_tracks.size(); i++)
+                delete (m_tracks[i]);
+            m_tracks.resize(trk + 1);
+            break;
         }
     }
-    filePos = m_file.tellg();
-    for (trk = 0; trk < ntrks; trk++)
+}
+
+// (Re)start decoding the tracks from the beginning, the events are decoded as they are merged
+void CMidiFile::startStreaming()
+{
+    size_t trk;
+
+    if (m_trackCount == 0)
+        return;
+
+    createTracks();
+    checkTracks();
+    for (trk = 0; trk < m_tracks.size(); trk++)
+        m_tracks[trk]->setStreaming(m_streamingHorizon * m_ppqn);
+    setSize(static_cast<int>(m_tracks.size()));
+    initMergedEvents();
+}
+
+// Called at the end of the first pass through a streamed song
+void CMidiFile::finishStreamingPass()
+{
+    size_t trk;
+
+    if (m_tracks.size() == 0)
+        return;
+
+    m_songTitle = m_tracks[0]->getTrackName();
+    findKeySignature();
+    // Like a song that is decoded up front only use the tracks up to and including the first bad track
+    for (trk = 0; trk < m_tracks.size(); trk++)
     {
-        m_tracks[trk] = new CMidiTrack(m_file, trk);
-        trackLength = m_tracks[trk]->getTrackLength();
-        m_tracks[trk]->decodeTrack();
         if (m_tracks[trk]->failed())
         {
             midiError(m_tracks[trk]->getMidiError());
-
+            m_trackCount = trk + 1;
             break;
         }
-        //now move onto the next track
-        filePos += trackLength;
-        m_file.seekg (filePos, ios::beg);
     }
+    collectSongText(m_trackCount);
+}
+
+// Decode all the tracks and merge them into m_songEvents, this is only done once per file
+void CMidiFile::decodeMidiFile()
+{
+    size_t ntrks;
+    size_t trk;
+
+    midiError(SMF_NO_ERROR);
+    m_ppqn = DEFAULT_PPQN;
+    m_songEvents.clear();
+    m_songTitle.clear();
+    m_keySig = NO_KEY_SIGNATURE;
+    m_majorKey = 0;
+    m_trackCount = 0;
+
+    m_filePos = 0;
+
+    ntrks = readHeader();
+    if (ntrks == 0)
+    {
+        midiError(SMF_CORRUPTED_MIDI_FILE);
+        ppLogError("Zero tracks in SMF file");
+        return;
+    }
+    m_tracksStart = m_filePos;
+    m_trackCount = ntrks;
+
+    if (m_streaming)
+    {
+        startStreaming();
+        return;
+    }
+
+    decodeTracks(createTracks());
+    checkTracks();
+
     m_songTitle = m_tracks[0]->getTrackName();
+    findKeySignature();
+    setSize(static_cast<int>(m_tracks.size()));
     initMergedEvents();
+
+    size_t totalEvents = 1; // one extra for the MIDI_PB_EOF
+    for (trk = 0; trk < m_tracks.size(); trk++)
+        totalEvents += m_tracks[trk]->length();
+    m_songEvents.reserve(totalEvents);
+
+    CMidiEvent event;
+    do
+    {
+        event = CMerge::readMidiEvent();
+        m_songEvents.push_back(event);
+        analyseEvent(event);
+    }
+    while (event.type() != MIDI_PB_EOF);
+
+    // The merged events and the text are all we need now
+    collectSongText(m_tracks.size());
+    deleteTracks();
 }
 
 bool CMidiFile::checkMidiEventFromStream(int streamIdx)
 {
-    if (streamIdx < 0 || streamIdx >= MAX_TRACKS)
+    if (streamIdx < 0 || streamIdx >= static_cast<int>(m_tracks.size()))
     {
         assert("streamIdx out of range");
         return false;
     }
-    if (m_tracks[streamIdx] != 0 && m_tracks[streamIdx]->length() > 0)
+    if (m_tracks[streamIdx]->hasEvent())
         return true;
+    // A streamed track can go bad part way through
+    if (m_tracks[streamIdx]->failed() && getMidiError() == SMF_NO_ERROR)
+        midiError(m_tracks[streamIdx]->getMidiError());
     return false;
 }
 
@@ -30,15 +30,26 @@
 #define __MIDIFILE_H__
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include "MidiEvent.h"
 #include "MidiTrack.h"
 #include "Merge.h"
+#include "SongCache.h"
+#include "MusicArchive.h"
 
 #define DEFAULT_PPQN        96      /* Standard value for pulse per quarter note */
+#define MIDI_HEADER_LENGTH  14      /* "MThd", the length and then 3 words */
 
 using namespace std;
-#define MAX_TRACKS  40
+
+// Examines each event as the song is merged, so the song can be analysed without reading it a second time
+class CMidiEventAnalyser
+{
+public:
+    virtual void examineMidiEvent(CMidiEvent event) = 0;
+    virtual ~CMidiEventAnalyser() {}
+};
 
 // Reads data from a standard MIDI file
 class CMidiFile : public CMerge
@@ -46,36 +57,132 @@ class CMidiFile : public CMerge
 public:
     CMidiFile()
     {
-        size_t i;
         midiError(SMF_NO_ERROR);
         m_ppqn = DEFAULT_PPQN;
-        setSize(MAX_TRACKS);
-        for (i = 0; i < arraySize(m_tracks); i++)
-            m_tracks[i] = 0;
+        m_filePos = 0;
+        m_fileLength = 0;
+        m_songEventData = 0;
+        m_songEventCount = 0;
+        m_songEventIndex = 0;
+        m_analyser = 0;
+        m_streaming = false;
+        m_streamingHorizon = 0;
+        m_tracksStart = 0;
+        m_trackCount = 0;
+        m_parallelDecode = true;
+        m_keySig = NO_KEY_SIGNATURE;
+        m_majorKey = 0;
     }
 
+    ~CMidiFile() { deleteTracks(); }
+
     void openMidiFile(string filename);
+    // Where to keep the .pbcache files, an empty directory turns the cache off
+    void setCacheDir(const QString& dir) { m_songCache.setCacheDir(dir); }
+    // Every event is passed to the analyser (once) when the file is opened
+    void setAnalyser(CMidiEventAnalyser* analyser) { m_analyser = analyser; }
+    // Decode the song as it is played rather than all of it when it is opened, this keeps the memory
+    // used the same for very long songs. The horizon is how many quarter notes to look ahead for a note off,
+    // 0 turns streaming off.
+    void setStreamingHorizon(int quarterNotes) { m_streamingHorizon = quarterNotes; }
+    // The tracks are decoded on the Qt global thread pool, turn this off if the caller is already
+    // running one song per core
+    void setParallelDecode(bool parallel) { m_parallelDecode = parallel; }
     int readWord(void);
     int readHeader(void);
-    void rewind();
+    void rewind()
+    {
+        m_songEventIndex = 0;
+        if (m_streaming)
+            startStreaming();
+    }
+    // Moves to an event of the merged song, this cannot be done when the song is streamed
+    bool seekToEvent(size_t index)
+    {
+        if (m_streaming || index > m_songEventCount)
+            return false;
+        m_songEventIndex = index;
+        return true;
+    }
+    size_t getEventIndex() { return m_songEventIndex; }
+    // All the events of the merged song, 0 if the song is being streamed
+    const CMidiEvent* getSongEvents() { return m_streaming ? 0 : m_songEventData; }
+    size_t getSongEventCount() { return m_streaming ? 0 : m_songEventCount; }
+    // Returns the next event from the merged song, the last event is always MIDI_PB_EOF
+    CMidiEvent readMidiEvent()
+    {
+        if (m_streaming)
+            return CMerge::readMidiEvent();
+        if (m_songEventIndex < m_songEventCount)
+            return m_songEventData[m_songEventIndex++];
+        CMidiEvent event;
+        event.setType(MIDI_PB_EOF);
+        return event;
+    }
     static int getPulsesPerQuarterNote(){return m_ppqn;}
     static int ppqnAdjust(float value) {
         return static_cast<int>((value * static_cast<float>(CMidiFile::getPulsesPerQuarterNote()))/DEFAULT_PPQN );
     }
     QString getSongTitle() {return m_songTitle;}
+    // The first key signature in the first track that has one (as the tracks used to be decoded in order),
+    // NO_KEY_SIGNATURE if the song has none
+    int getKeySignature() {return m_keySig;}
+    int getMajorKey() {return m_majorKey;}
+    // The lyrics, markers and text of the song, for a streamed song they are there once the file has been opened
+    CSongText* getSongText() {return &m_songText;}
 
     void setLogLevel(int level){CMidiTrack::setLogLevel(level);}
     midiErrors_t getMidiError() { return m_midiError;}
     
 private:
+    void decodeMidiFile();
+    size_t createTracks();
+    void decodeTracks(size_t tracksFound);
+    void checkTracks();
+    void startStreaming();
+    void finishStreamingPass();
+    void deleteTracks();
+    void collectSongText(size_t trackCount);
+    void findKeySignature();
    	bool checkMidiEventFromStream(int streamIdx);
 	CMidiEvent fetchMidiEventFromStream(int streamIdx);
     void midiError(midiErrors_t error) {m_midiError = error;}
-    fstream m_file;
-    static int m_ppqn;
+    void analyseEvent(const CMidiEvent& event)
+    {
+        if (m_analyser != 0)
+            m_analyser->examineMidiEvent(event);
+    }
+    int readByte(void)
+    {
+        if (m_filePos >= m_fileData.size())
+            return -1;
+        return m_fileData[m_filePos++];
+    }
+
+    vector<byte_t> m_fileData; // The whole midi file is read into memory once (only the header when streaming)
+    size_t m_filePos;
+    size_t m_fileLength;
+    ifstream m_file;           // Kept open while the song is streamed
+    vector<CMidiEvent> m_songEvents;  // All the tracks merged into one stream, built once when the file is opened
+    CSongCache m_songCache;
+    CMusicArchive m_musicArchive;   // The zip file of the last song that was read from a zip
+    const CMidiEvent* m_songEventData; // Either m_songEvents or the events in the mapped song cache
+    size_t m_songEventCount;
+    size_t m_songEventIndex;
+    CMidiEventAnalyser* m_analyser;
+    bool m_streaming;           // The current song is being decoded as it is read
+    int m_streamingHorizon;
+    size_t m_tracksStart;       // Where the first track starts in m_fileData
+    size_t m_trackCount;        // The number of tracks in the header
+    bool m_parallelDecode;
+    // The ppqn of the last song opened on this thread, so songs can be read on several threads at once
+    static thread_local int m_ppqn;
     midiErrors_t m_midiError;
-    CMidiTrack* m_tracks[MAX_TRACKS];
+    vector<CMidiTrack*> m_tracks;  // Only used while the file is being decoded (or streamed)
     QString m_songTitle;
+    int m_keySig;
+    int m_majorKey;
+    CSongText m_songText;
 };
 
 #endif // __MIDIFILE_H__
@@ -0,0 +1,116 @@
+/*********************************************************************************/
+/*!
+@file           MidiScheduler.cpp
+
+@brief          Sends midi events to the midi device at the time they are due.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include "MidiScheduler.h"
+#include "MidiDeviceBase.h"
+#include "Util.h"
+
+// The wait on the condition is only to the nearest msec and may be late, so it stops this long
+// before the event is due and the rest is slept until the exact time
+#define FINE_WAIT_USEC  2000
+
+CMidiScheduler::CMidiScheduler(CMidiDeviceBase* device)
+{
+    m_device = device;
+    m_stop = false;
+    start(QThread::TimeCriticalPriority);
+}
+
+CMidiScheduler::~CMidiScheduler()
+{
+    m_mutex.lock();
+    m_stop = true;
+    m_eventAdded.wakeAll();
+    m_mutex.unlock();
+    wait();
+}
+
+void CMidiScheduler::scheduleEvent(const CMidiEvent& event, qint64 time)
+{
+    scheduledMidiEvent_t scheduled;
+    scheduled.time = time;
+    scheduled.event = event;
+
+    QMutexLocker locker(&m_mutex);
+    // The events nearly always arrive in time order, so look for the place from the end
+    deque<scheduledMidiEvent_t>::iterator it = m_events.end();
+    while (it != m_events.begin() && (it - 1)->time > time)
+        --it;
+    bool first = (it == m_events.begin());
+    m_events.insert(it, scheduled);
+    // Only wake the thread if it is now sleeping for too long
+    if (first)
+        m_eventAdded.wakeAll();
+}
+
+void CMidiScheduler::flush()
+{
+    QMutexLocker locker(&m_mutex);
+    m_events.clear();
+}
+
+int CMidiScheduler::length()
+{
+    QMutexLocker locker(&m_mutex);
+    return static_cast<int>(m_events.size());
+}
+
+void CMidiScheduler::run()
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_stop)
+    {
+        if (m_events.empty())
+        {
+            m_eventAdded.wait(&m_mutex);
+            continue;
+        }
+        qint64 dueTime = m_events.front().time;
+        qint64 waitTime = dueTime - ppTimeMicros();
+        if (waitTime > FINE_WAIT_USEC)
+        {
+            // A coarse wait that an earlier event or stopping can cut short
+            m_eventAdded.wait(&m_mutex, static_cast<unsigned long>((waitTime - FINE_WAIT_USEC + 999) / 1000));
+            continue;
+        }
+        if (waitTime > 0)
+        {
+            // On the same steady clock as ppTimeMicros(), the events are checked again afterwards
+            // as they may have been flushed or an earlier one added while the lock was released
+            locker.unlock();
+            std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::microseconds(dueTime)));
+            locker.relock();
+            continue;
+        }
+        // Sent with the lock held, so nothing is still on its way once flush() returns
+        m_device->playMidiEvent(m_events.front().event);
+        m_events.pop_front();
+    }
+}
@@ -0,0 +1,79 @@
+/*********************************************************************************/
+/*!
+@file           MidiScheduler.h
+
+@brief          Sends midi events to the midi device at the time they are due.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __MIDI_SCHEDULER_H__
+#define __MIDI_SCHEDULER_H__
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThread>
+#include <deque>
+#include "MidiEvent.h"
+
+using namespace std;
+
+class CMidiDeviceBase;
+
+// A midi event waiting to be sent
+typedef struct
+{
+    qint64 time;            // When to send it, see ppTimeMicros()
+    CMidiEvent event;
+} scheduledMidiEvent_t;
+
+/*!
+ * @brief   A thread that sends the midi events to the device at their time.
+ *
+ * The engine only runs once a frame, so it hands over the events a little before they are due and
+ * this thread sleeps until each one's time. The events are sent with the device's playMidiEvent(),
+ * which must be safe to call from this thread.
+ */
+class CMidiScheduler : public QThread
+{
+public:
+    CMidiScheduler(CMidiDeviceBase* device);
+    ~CMidiScheduler();
+
+    // Send the event at the time (see ppTimeMicros()), events at the same time are sent in the order they were added
+    void scheduleEvent(const CMidiEvent& event, qint64 time);
+    // Throw away all the events that have not yet been sent, none are sent after this returns
+    void flush();
+    int length();
+
+protected:
+    void run();
+
+private:
+    CMidiDeviceBase* m_device;
+    QMutex m_mutex;                     // Guards the members below
+    QWaitCondition m_eventAdded;
+    deque<scheduledMidiEvent_t> m_events;  // In time order
+    bool m_stop;
+};
+
+#endif // __MIDI_SCHEDULER_H__
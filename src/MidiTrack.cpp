@@ -27,9 +27,9 @@
 /*********************************************************************************/
 
 #include <stdarg.h>
+#include <string.h>
 #include "MidiTrack.h"
 #include "Util.h"
-#include "StavePosition.h"
 
 #define OPTION_DEBUG_TRACK     0
 #if OPTION_DEBUG_TRACK
@@ -40,9 +40,28 @@
 
 int CMidiTrack::m_logLevel;
 
-CMidiTrack::CMidiTrack(fstream& file, int no) :m_file(file), m_trackNumber(no)
+CMidiTrack::CMidiTrack(const byte_t* data, dword_t dataLength, int no) :m_dataPtr(data), m_dataEnd(data + dataLength), m_trackNumber(no)
 {
-    m_trackEventQueue = 0;
+    m_file = 0;
+    m_filePos = 0;
+    m_fileLength = 0;
+    readTrackHeader();
+}
+
+CMidiTrack::CMidiTrack(istream* file, dword_t filePos, dword_t fileLength, int no) :m_dataPtr(0), m_dataEnd(0), m_trackNumber(no)
+{
+    m_file = file;
+    m_filePos = filePos;
+    m_fileLength = fileLength;
+    readTrackHeader();
+}
+
+void CMidiTrack::readTrackHeader()
+{
+    m_readIndex = 0;
+    m_eventBase = 0;
+    m_streamHorizon = 0;
+    m_trackLength = 0;
     m_savedRunningStatus = 0;
     m_trackLengthCounter = 0;
     m_deltaTime = 0;
@@ -51,16 +70,23 @@ CMidiTrack::CMidiTrack(fstream& file, int no) :m_file(file), m_trackNumber(no)
 
     for ( int chan = 0; chan <MAX_MIDI_CHANNELS; chan++ )
     {
-        m_noteOnEventPtr[chan] = 0;
+        for (int pitch = 0; pitch < MAX_MIDI_NOTES; pitch++)
+        {
+            m_noteOnEventIdx[chan][pitch] = -1;
+            m_restruckPitchCount[chan][pitch] = 0;
+        }
     }
+    m_restruckCount = 0;
 
     int i;
 
     m_trackName.clear();
+    m_keySig = NO_KEY_SIGNATURE;
+    m_majorKey = 0;
     m_trackLengthCounter = 8;
     for ( i=0; i < 4; i++)
     {
-        if (m_file.get() !="MTrk"[i] )
+        if (readByte() !="MTrk"[i] )
         {
             ppLogError("No valid Midi tracks");
             errorFail(SMF_CORRUPTED_MIDI_FILE);
@@ -70,13 +96,38 @@ CMidiTrack::CMidiTrack(fstream& file, int no) :m_file(file), m_trackNumber(no)
     m_trackLengthCounter = readDWord();
     ppDEBUG_TRACK((9, "Track Length %d", m_trackLengthCounter));
 
-    m_filePos = m_file.tellg();
     m_trackLength = m_trackLengthCounter + 8; // 4 bytes for the "MTrk" + 4 bytes for the track length
-    m_trackEventQueue = new CQueue<CMidiEvent>(m_trackLength/3); // The minimum bytes per event is 3
 }
 
 
 
+// Read the next part of the track from the file, only used when the track is not already in memory
+bool CMidiTrack::refillData()
+{
+    const dword_t chunkSize = 16 * 1024;
+
+    if (m_file == 0 || m_filePos >= m_fileLength)
+        return false;
+
+    dword_t length = m_fileLength - m_filePos;
+    if (length > chunkSize)
+        length = chunkSize;
+    m_fileBuffer.resize(length);
+
+    // The file is shared with the other tracks
+    m_file->clear();
+    m_file->seekg(m_filePos);
+    m_file->read(reinterpret_cast<char*>(&m_fileBuffer[0]), length);
+    length = static_cast<dword_t>(m_file->gcount());
+    if (length == 0)
+        return false;
+
+    m_filePos += length;
+    m_dataPtr = &m_fileBuffer[0];
+    m_dataEnd = m_dataPtr + length;
+    return true;
+}
+
 void CMidiTrack::ppDebugTrack(int level, const char *msg, ...)
 {
     va_list ap;
@@ -125,12 +176,14 @@ string CMidiTrack::readTextEvent()
 
     string text;
     length = readVarLen();
-    if (length >= 100)
+    // The text can be any length but must fit in what is left of the track
+    if (length > m_trackLengthCounter)
     {
-        ppLogError("Text Event too large %d", length);
+        ppLogError("Text Event too large %lu", length);
         errorFail(SMF_END_OF_FILE);
         return text;
     }
+    text.reserve(length);
     while (length--)
     {
         if (failed() == true)
@@ -140,6 +193,16 @@ string CMidiTrack::readTextEvent()
     return text;
 }
 
+// Keep the text so it can be shown as the song is played
+void CMidiTrack::readSongTextEvent(songTextType_t type)
+{
+    string text = readTextEvent();
+    if (failed() == true)
+        return;
+    m_songText.add(m_currentTime, type, text);
+    ppDEBUG_TRACK((2,"Text type %d at %d %s", type, m_currentTime, text.c_str()));
+}
+
 dword_t CMidiTrack::readDataEvent(int expectedLength)
 {
     int length;
@@ -214,7 +277,7 @@ void CMidiTrack::readTimeSignatureEvent()
     b3 = readByte();           /* Ignore the last bytes */
     b4 = readByte();           /* Ignore the last bytes */
     event.metaEvent(readDelaTime(), MIDI_PB_timeSignature, timeSigNumerator, 1<<timeSigDenominator);
-    m_trackEventQueue->push(event);
+    m_trackEvents.push_back(event);
     ppDEBUG_TRACK((4,"Key Signature %d/%d metronome %d quarter %d", timeSigNumerator, 1<<timeSigDenominator, b3, b4));
 }
 
@@ -241,10 +304,13 @@ void CMidiTrack::readKeySignatureEvent()
     }
 
     event.metaEvent(readDelaTime(), MIDI_PB_keySignature, keySig, majorKey);
-    m_trackEventQueue->push(event);
+    m_trackEvents.push_back(event);
     ppDEBUG_TRACK((4,"Key Signature %d maj/min %d", keySig, majorKey));
-    if (CStavePos::getKeySignature() == NOT_USED)
-        CStavePos::setKeySignature(event.data1(), event.data2());
+    if (m_keySig == NO_KEY_SIGNATURE)
+    {
+        m_keySig = keySig;
+        m_majorKey = majorKey;
+    }
 }
 
 
@@ -302,8 +368,8 @@ void CMidiTrack::readMetaEvent(byte_t type)
         b2 = readByte();
         b3 = readByte();
         tempo = b1 << 16 | b2 << 8 | b3; // microseconds per quarter-note#
-        event.metaEvent(readDelaTime(), MIDI_PB_tempo, tempo, 0);
-        m_trackEventQueue->push(event);
+        event.tempoEvent(readDelaTime(), tempo);
+        m_trackEvents.push_back(event);
         ppDEBUG_TRACK((2,"Set Tempo %d", tempo));
         break;
     }
@@ -317,23 +383,19 @@ void CMidiTrack::readMetaEvent(byte_t type)
         break;
 
     case METATEXT:                      /* Text Event */
-        text = readTextEvent();
-        ppDEBUG_TRACK((2,"Text %s", text.c_str()));
+        readSongTextEvent(SONG_TEXT_text);
         break;
 
     case METALYRIC:                         /* Lyric */
-        text = readTextEvent();
-        ppDEBUG_TRACK((2,"Lyric %s", text.c_str()));
+        readSongTextEvent(SONG_TEXT_lyric);
         break;
 
     case METAMARKER:
-        text = readTextEvent();
-        ppDEBUG_TRACK((2,"METAMARKER %s", text.c_str()));
+        readSongTextEvent(SONG_TEXT_marker);
         break;
 
     case METACUEPT:
-        text = readTextEvent();
-        ppDEBUG_TRACK((2,"METACUEPT %s", text.c_str()));
+        readSongTextEvent(SONG_TEXT_cuePoint);
         break;
 
     case METACHANPFX:                         /* Midi Channel Prefix */
@@ -392,28 +454,89 @@ void CMidiTrack::decodeSystemMessage( byte_t status, byte_t data1 )
     }
 }
 
-void CMidiTrack::noteOffEvent(CMidiEvent &event, int deltaTime, int channel, int pitch, int velocity)
+// Remember where the note on is so its duration can be set by the note off
+void CMidiTrack::noteOnStarted(int channel, int pitch, int eventIdx)
 {
-    createNoteEventPtr(channel);
+    if (m_noteOnEventIdx[channel][pitch] >= 0)
+    {
+        if (m_restruckCount == MAX_RESTRUCK_NOTES)
+        {
+            // The oldest note on now never gets its note off
+            ppLogWarn("Missing note off duration Chan %d Note on %d", m_restruckNotes[0].channel + 1, m_restruckNotes[0].pitch);
+            m_restruckPitchCount[m_restruckNotes[0].channel][m_restruckNotes[0].pitch]--;
+            memmove(&m_restruckNotes[0], &m_restruckNotes[1], (MAX_RESTRUCK_NOTES - 1) * sizeof(restruckNote_t));
+            m_restruckCount--;
+        }
+        restruckNote_t& restruck = m_restruckNotes[m_restruckCount++];
+        restruck.channel = channel;
+        restruck.pitch = pitch;
+        restruck.eventIdx = m_noteOnEventIdx[channel][pitch];
+        m_restruckPitchCount[channel][pitch]++;
+    }
+    m_noteOnEventIdx[channel][pitch] = eventIdx;
+}
 
-    CMidiEvent* noteOnEventPtr = m_noteOnEventPtr[channel][pitch];
+// Returns the note on that this note off finishes (-1 if none), a re-struck note finishes the latest note on first
+int CMidiTrack::noteOnFinished(int channel, int pitch)
+{
+    int eventIdx = m_noteOnEventIdx[channel][pitch];
 
-    if (noteOnEventPtr)
+    m_noteOnEventIdx[channel][pitch] = -1;
+    if (m_restruckPitchCount[channel][pitch] == 0)
+        return eventIdx;
+    for (int i = m_restruckCount - 1; i >= 0; i--)
     {
-        int duration = m_currentTime - noteOnEventPtr->getDuration();
-        noteOnEventPtr->setDuration(duration);
-        //ppLogDebug ("NOTE OFF chan %d pitch %d  currentTime %d Duration %d", channel + 1, pitch, m_currentTime, duration);
+        if (m_restruckNotes[i].channel == channel && m_restruckNotes[i].pitch == pitch)
+        {
+            m_noteOnEventIdx[channel][pitch] = m_restruckNotes[i].eventIdx;
+            m_restruckPitchCount[channel][pitch]--;
+            m_restruckCount--;
+            memmove(&m_restruckNotes[i], &m_restruckNotes[i + 1], (m_restruckCount - i) * sizeof(restruckNote_t));
+            break;
+        }
+    }
+    return eventIdx;
+}
+
+// Returns true if the note on is still waiting for its note off
+bool CMidiTrack::noteOnPending(int channel, int pitch, int eventIdx)
+{
+    if (m_noteOnEventIdx[channel][pitch] == eventIdx)
+        return true;
+    // Only a re-struck note needs the (short) stack to be searched
+    if (m_restruckPitchCount[channel][pitch] == 0)
+        return false;
+    for (int i = m_restruckCount - 1; i >= 0; i--)
+    {
+        if (m_restruckNotes[i].eventIdx == eventIdx)
+            return true;
+    }
+    return false;
+}
+
+void CMidiTrack::noteOffEvent(CMidiEvent &event, int deltaTime, int channel, int pitch, int velocity)
+{
+    int noteOnEventIdx = noteOnFinished(channel, pitch);
+
+    if (noteOnEventIdx >= 0)
+    {
+        // When streaming the note on may have already been popped with the horizon as its duration
+        if (noteOnEventIdx >= m_eventBase + static_cast<int>(m_readIndex))
+        {
+            CMidiEvent& noteOnEvent = m_trackEvents[noteOnEventIdx - m_eventBase];
+            int duration = m_currentTime - noteOnEvent.getDuration();
+            noteOnEvent.setDuration(duration);
+            //ppLogDebug ("NOTE OFF chan %d pitch %d  currentTime %d Duration %d", channel + 1, pitch, m_currentTime, duration);
+        }
     }
     else
     {
         ppLogWarn("Missing note off duration Chan %d Note off %d", channel + 1, pitch);
     }
-    m_noteOnEventPtr[channel][pitch] = 0;
-
 
     event.noteOffEvent(deltaTime, channel, pitch, velocity);
 
-    m_trackEventQueue->push(event);
+    m_trackEvents.push_back(event);
     ppDEBUG_TRACK((1,"Chan %d Note off %d", channel + 1, pitch));
 }
 
@@ -464,11 +587,9 @@ void CMidiTrack::decodeMidiEvent()
             event.setDuration(m_currentTime); // Set the duration to the current time for now
             //ppLogDebug ("NOTE ON  pitch %d m_currentTime %d event->getDuration() %d", data1, m_currentTime, event.getDuration());
 
-            CMidiEvent* eventPtr = m_trackEventQueue->push(event);
-
-            // Save a reference to the note on event
-            createNoteEventPtr(channel);
-            m_noteOnEventPtr[channel] [data1]  = eventPtr;
+            // Save the index rather than a pointer as the vector may move when it grows
+            noteOnStarted(channel, data1, m_eventBase + static_cast<int>(m_trackEvents.size()));
+            m_trackEvents.push_back(event);
         }
         else
         {
@@ -479,33 +600,33 @@ void CMidiTrack::decodeMidiEvent()
     case MIDI_NOTE_PRESSURE :              /* Key pressure After touch (POLY_AFTERTOUCH)  3 bytes */
         data2 = readByte();
         event.notePressure(readDelaTime(), channel, data1, data2);
-        m_trackEventQueue->push(event);
+        m_trackEvents.push_back(event);
         ppDEBUG_TRACK((2,"Chan %d After touch", channel + 1));
         break;
 
     case MIDI_PROGRAM_CHANGE :               /* program change */
         event.programChangeEvent(readDelaTime(), channel, data1);
-        m_trackEventQueue->push(event);
+        m_trackEvents.push_back(event);
         ppDEBUG_TRACK((2,"Chan %d Program change %d", channel + 1, data1 + 1));
         break;
 
     case MIDI_CONTROL_CHANGE :               /* Control Change */
         data2 = readByte();
         event.controlChangeEvent(readDelaTime(), channel, data1, data2);
-        m_trackEventQueue->push(event);
+        m_trackEvents.push_back(event);
         ppDEBUG_TRACK((2,"Chan %d Control Change %d %d", channel + 1, data1, data2));
         break;
 
     case MIDI_CHANNEL_PRESSURE:            /* Channel Pressure (AFTERTOUCH)*/
         event.channelPressure(readDelaTime(), channel, data1);
-        m_trackEventQueue->push(event);
+        m_trackEvents.push_back(event);
         ppDEBUG_TRACK((2,"Chan %d Channel Pressure", channel + 1));
         break;
 
     case MIDI_PITCH_BEND:    /* Pitch bend */
         data2 = readByte();
         event.pitchBendEvent(readDelaTime(), channel, data1, data2);
-        m_trackEventQueue->push(event);
+        m_trackEvents.push_back(event);
         ppDEBUG_TRACK((2,"Chan %d Pitch bend",channel + 1));
         break;
 
@@ -520,19 +641,65 @@ void CMidiTrack::decodeTrack()
 {
     CMidiEvent event;
 
-    m_file.seekg(m_filePos, ios::beg);
+    if (failed() == true) // The track header was not valid
+        return;
+
+    // Most events take at least 3 bytes so this is normally the only allocation,
+    // running status can pack them tighter in which case the vector just grows
+    m_trackEvents.reserve(m_trackLength/3 + 1);
     while (true)
     {
         if (m_trackLengthCounter== 0)
             break;
-        if (m_trackEventQueue->space() <= 1)
-        {
-            ppLogError("Out of Space");
-            break;
-        }
         decodeMidiEvent();
         if (failed() == true)
             break;
     }
-    m_filePos = m_file.tellg();
+}
+
+// Returns true if the next event can be popped, a note on must wait for its duration
+bool CMidiTrack::streamEventReady()
+{
+    if (m_readIndex >= m_trackEvents.size())
+        return false;
+
+    CMidiEvent& event = m_trackEvents[m_readIndex];
+    if (event.type() != MIDI_NOTE_ON)
+        return true;
+
+    // The end of the track, leave any unfinished notes as they are
+    if (m_trackLengthCounter == 0 || failed() == true)
+        return true;
+
+    if (noteOnPending(event.channel(), event.note(), m_eventBase + static_cast<int>(m_readIndex)) == false)
+        return true; // The note off has been found
+
+    // Don't wait any longer for the note off, the note on still holds its start time
+    int soFar = m_currentTime - event.getDuration();
+    if (soFar >= m_streamHorizon)
+    {
+        event.setDuration(soFar);
+        return true;
+    }
+    return false;
+}
+
+// Decode just enough of the track for the next event to be popped
+bool CMidiTrack::streamNextEvent()
+{
+    while (streamEventReady() == false)
+    {
+        if (m_trackLengthCounter == 0 || failed() == true)
+            return false;
+
+        // Drop the events that have been popped so the memory used stays the same size
+        if (m_readIndex >= 256 && m_readIndex * 2 >= m_trackEvents.size())
+        {
+            m_trackEvents.erase(m_trackEvents.begin(), m_trackEvents.begin() + m_readIndex);
+            m_eventBase += static_cast<int>(m_readIndex);
+            m_readIndex = 0;
+        }
+        decodeMidiEvent();
+    }
+    return true;
 }
@@ -30,13 +30,16 @@
 #define __MIDITRACK_H__
 #include <QString>
 #include <string>
-#include <fstream>
-#include "Queue.h"
+#include <istream>
+#include <vector>
 #include "MidiEvent.h"
+#include "SongText.h"
 
 using namespace std;
 
-
+// The most note ons that can wait for a note off after being struck again, the oldest is forgotten
+// (like a missing note off) when there are more, so a drum track without note offs stays cheap
+#define MAX_RESTRUCK_NOTES  32
 
 typedef enum
 {
@@ -58,16 +61,11 @@ typedef unsigned long dword_t;
 class CMidiTrack
 {
 public:
-    CMidiTrack(fstream& file, int no);
+    CMidiTrack(const byte_t* data, dword_t dataLength, int no);
+    // Reads the track a bit at a time from the file starting at filePos
+    CMidiTrack(istream* file, dword_t filePos, dword_t fileLength, int no);
 
-    ~CMidiTrack()
-    {
-        delete m_trackEventQueue;
-        for ( int chan =0; chan <MAX_MIDI_CHANNELS; chan++ )
-        {
-            delete [] m_noteOnEventPtr[chan];
-        }
-    }
+    ~CMidiTrack() {}
 
     int readDelaTime()
     {
@@ -78,12 +76,27 @@ public:
 
     dword_t getTrackLength() {return m_trackLength;}
     void decodeTrack();
+
+    // Decode the track a bit at a time as the events are popped instead of all in one go.
+    // A note on is held back until its note off is found or the horizon (in ticks) has passed.
+    void setStreaming(int horizon) { m_streamHorizon = horizon; }
+    bool hasEvent()
+    {
+        if (m_streamHorizon == 0)
+            return length() > 0;
+        return streamNextEvent();
+    }
     bool failed() { return (m_midiError != SMF_NO_ERROR) ? true : false;}
     midiErrors_t getMidiError() { return m_midiError;}
 
-    int length() {return m_trackEventQueue->length();}
-    CMidiEvent pop() {return m_trackEventQueue->pop();}
+    int length() {return static_cast<int>(m_trackEvents.size() - m_readIndex);}
+    CMidiEvent pop() {return m_trackEvents[m_readIndex++];}
     QString getTrackName() {return m_trackName;}
+    // The first key signature in the track, NO_KEY_SIGNATURE if there is none
+    int getKeySignature() {return m_keySig;}
+    int getMajorKey() {return m_majorKey;}
+    // The lyrics, markers and text in the track (only the part decoded so far when streaming)
+    const CSongText& getSongText() {return m_songText;}
 
     static void setLogLevel(int level){m_logLevel = level;}
 
@@ -105,17 +118,20 @@ private:
 
     byte_t readByte(void)
     {
-        int c;
+        byte_t c = 0;
 
         if (m_trackLengthCounter != 0 )
         {
-            c = m_file.get();
-            if (m_file.fail() == true)
+            // The track length in the header may claim more bytes than there are in the file
+            if (m_dataPtr < m_dataEnd || refillData())
+                c = *m_dataPtr++;
+            else
+            {
+                c = 0xff; // the same value fstream::get() used to return at the end of the file
                 errorFail(SMF_END_OF_FILE);
+            }
             m_trackLengthCounter--;
         }
-        else
-            c = 0;
         return c;
     }
 
@@ -138,10 +154,15 @@ private:
         return value;
     }
 
+    void readTrackHeader();
+    bool refillData();
     void decodeMidiEvent();
+    bool streamNextEvent();
+    bool streamEventReady();
     dword_t readVarLen();
 
     string readTextEvent();
+    void readSongTextEvent(songTextType_t type);
     dword_t readDataEvent(int expectedLength);
     void readMetaEvent(byte_t type);
     void ignoreSysexEvent(byte_t data);
@@ -153,30 +174,45 @@ private:
     void noteOffEvent(CMidiEvent &event,  int deltaTime, int channel, int pitch, int velocity);
 
 
-    void createNoteEventPtr(int channel)
-    {
-        if (m_noteOnEventPtr[channel] == 0)
-        {
-            m_noteOnEventPtr[channel] = new CMidiEvent*[MAX_MIDI_NOTES];
-            for (int pitch = 0; pitch < MAX_MIDI_NOTES; pitch++)
-                m_noteOnEventPtr[channel][pitch] = 0;
-        }
-    }
+    void noteOnStarted(int channel, int pitch, int eventIdx);
+    int noteOnFinished(int channel, int pitch);
+    bool noteOnPending(int channel, int pitch, int eventIdx);
 
-    fstream& m_file;
+    // A note on that was struck again before its note off
+    typedef struct
+    {
+        int channel;
+        int pitch;
+        int eventIdx;
+    } restruckNote_t;
+
+    const byte_t* m_dataPtr;   // The next byte to be decoded (points into the CMidiFile buffer or m_fileBuffer)
+    const byte_t* m_dataEnd;   // One past the last byte of the midi file (or of m_fileBuffer)
+    istream* m_file;           // Only set if the track is read from the file as it is decoded
+    dword_t m_filePos;
+    dword_t m_fileLength;
+    vector<byte_t> m_fileBuffer;
     int m_trackNumber;
 
-    streampos m_filePos;
     dword_t m_trackLength;
     dword_t m_trackLengthCounter;
-    CQueue<CMidiEvent>* m_trackEventQueue;
+    vector<CMidiEvent> m_trackEvents;   // Grows as the track is decoded
+    size_t m_readIndex;                 // The next event to be popped
+    int m_eventBase;                    // The event number of m_trackEvents[0] (events are only dropped when streaming)
+    int m_streamHorizon;                // 0 if the whole track is decoded up front
     int m_savedRunningStatus;
     int m_deltaTime;
     int m_currentTime;      // The current time (all the delta times added up)
     midiErrors_t m_midiError;
     QString m_trackName;
+    int m_keySig;
+    int m_majorKey;
+    CSongText m_songText;
     static int m_logLevel;
-    CMidiEvent** m_noteOnEventPtr[MAX_MIDI_CHANNELS];
+    int m_noteOnEventIdx[MAX_MIDI_CHANNELS][MAX_MIDI_NOTES]; // The event number of each sounding note (-1 if none)
+    restruckNote_t m_restruckNotes[MAX_RESTRUCK_NOTES]; // The earlier note ons, the last one is the most recent
+    int m_restruckCount;
+    unsigned char m_restruckPitchCount[MAX_MIDI_CHANNELS][MAX_MIDI_NOTES]; // How many of each note are in m_restruckNotes
 };
 
 #endif // __MIDITRACK_H__
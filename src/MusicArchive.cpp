@@ -0,0 +1,266 @@
+/*********************************************************************************/
+/*!
+@file           MusicArchive.cpp
+
+@brief          Reads the songs straight out of a zip file (BoosterMusicBooks.zip).
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include <string.h>
+#include <QFileInfo>
+#include <QDir>
+#include <zlib.h>
+
+#include "MusicArchive.h"
+#include "Util.h"
+
+#define ZIP_END_OF_DIR_SIGNATURE    0x06054b50
+#define ZIP_DIR_ENTRY_SIGNATURE     0x02014b50
+#define ZIP_LOCAL_HEADER_SIGNATURE  0x04034b50
+#define ZIP_END_OF_DIR_LENGTH       22
+#define ZIP_DIR_ENTRY_LENGTH        46
+#define ZIP_LOCAL_HEADER_LENGTH     30
+#define ZIP_MAX_COMMENT_LENGTH      0xffff
+
+// The numbers in a zip file are little endian
+static quint16 readZipWord(const uchar* data)
+{
+    return static_cast<quint16>(data[0] | (data[1] << 8));
+}
+
+static quint32 readZipDWord(const uchar* data)
+{
+    return static_cast<quint32>(readZipWord(data)) | (static_cast<quint32>(readZipWord(data + 2)) << 16);
+}
+
+bool CMusicArchive::splitPath(const QString& path, QString* zipFileName, QString* entryName)
+{
+    QString fullPath = QDir::fromNativeSeparators(path);
+    int index = fullPath.indexOf(".zip/", 0, Qt::CaseInsensitive);
+    if (index < 0)
+        return false;
+    if (zipFileName != 0)
+        *zipFileName = fullPath.left(index + 4);
+    if (entryName != 0)
+        *entryName = fullPath.mid(index + 5);
+    return true;
+}
+
+void CMusicArchive::close()
+{
+    if (m_mappedData != 0)
+        m_zipFile.unmap(const_cast<uchar*>(m_mappedData));
+    if (m_zipFile.isOpen())
+        m_zipFile.close();
+    m_mappedData = 0;
+    m_mappedSize = 0;
+    m_entries.clear();
+    m_zipFileName.clear();
+}
+
+bool CMusicArchive::open(const QString& zipFileName)
+{
+    close();
+
+    m_zipFile.setFileName(zipFileName);
+    if (!m_zipFile.open(QIODevice::ReadOnly))
+        return false;
+
+    m_mappedSize = m_zipFile.size();
+    if (m_mappedSize >= ZIP_END_OF_DIR_LENGTH)
+        m_mappedData = m_zipFile.map(0, m_mappedSize);
+
+    if (m_mappedData == 0 || !readDirectory())
+    {
+        ppLogError("Cannot read the zip file %s", qPrintable(zipFileName));
+        close();
+        return false;
+    }
+    m_zipFileName = QFileInfo(zipFileName).absoluteFilePath();
+    ppLogInfo("Opened %s (%d files)", qPrintable(m_zipFileName), m_entries.size());
+    return true;
+}
+
+// Reads the zip's central directory, which lists every file in the zip
+bool CMusicArchive::readDirectory()
+{
+    // The end of directory record is at the end of the zip, before the zip comment
+    qint64 endOfDir = m_mappedSize - ZIP_END_OF_DIR_LENGTH;
+    qint64 searchLimit = qMax(static_cast<qint64>(0), endOfDir - ZIP_MAX_COMMENT_LENGTH);
+    while (endOfDir >= searchLimit && readZipDWord(m_mappedData + endOfDir) != ZIP_END_OF_DIR_SIGNATURE)
+        endOfDir--;
+    if (endOfDir < searchLimit)
+        return false;
+
+    const uchar* record = m_mappedData + endOfDir;
+    int entryCount = readZipWord(record + 10);
+    qint64 dirPos = readZipDWord(record + 16);
+
+    for (int i = 0; i < entryCount; i++)
+    {
+        if (dirPos + ZIP_DIR_ENTRY_LENGTH > endOfDir)
+            return false;
+        const uchar* entryData = m_mappedData + dirPos;
+        if (readZipDWord(entryData) != ZIP_DIR_ENTRY_SIGNATURE)
+            return false;
+
+        quint16 flags = readZipWord(entryData + 8);
+        int nameLength = readZipWord(entryData + 28);
+        int extraLength = readZipWord(entryData + 30);
+        int commentLength = readZipWord(entryData + 32);
+        if (dirPos + ZIP_DIR_ENTRY_LENGTH + nameLength > endOfDir)
+            return false;
+
+        zipEntry_t entry;
+        entry.method = readZipWord(entryData + 10);
+        entry.compressedSize = readZipDWord(entryData + 20);
+        entry.size = readZipDWord(entryData + 24);
+        entry.localHeaderOffset = readZipDWord(entryData + 42);
+
+        const char* name = reinterpret_cast<const char*>(entryData + ZIP_DIR_ENTRY_LENGTH);
+        // bit 11 is set if the name is utf8
+        QString entryName = (flags & 0x800) ? QString::fromUtf8(name, nameLength) : QString::fromLocal8Bit(name, nameLength);
+
+        // Skip the folders and any encrypted files
+        if (!entryName.endsWith('/') && (flags & 0x01) == 0)
+            m_entries.insert(entryName, entry);
+
+        dirPos += ZIP_DIR_ENTRY_LENGTH + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+// Returns the name of the file in the zip or an empty string if the path is not in this zip
+QString CMusicArchive::entryName(const QString& path)
+{
+    QString zipFileName;
+    QString name;
+    if (!isOpen() || !splitPath(path, &zipFileName, &name))
+        return QString();
+    if (zipFileName != m_zipFileName && QFileInfo(zipFileName).absoluteFilePath() != m_zipFileName)
+        return QString();
+    return name;
+}
+
+bool CMusicArchive::contains(const QString& path)
+{
+    QString zipFileName;
+    if (!isOpen() || !splitPath(path, &zipFileName, 0))
+        return false;
+    return (zipFileName == m_zipFileName || QFileInfo(zipFileName).absoluteFilePath() == m_zipFileName);
+}
+
+bool CMusicArchive::exists(const QString& path)
+{
+    QString name = entryName(path);
+    return (!name.isEmpty() && m_entries.contains(name));
+}
+
+QStringList CMusicArchive::entryList(const QString& dirPath, bool folders)
+{
+    QStringList names;
+    if (!contains(dirPath))
+        return names;
+
+    QString prefix = entryName(dirPath);
+    if (!prefix.isEmpty() && !prefix.endsWith('/'))
+        prefix += '/';
+
+    // The files in a folder are next to each other as the entries are sorted by name
+    QMap<QString, zipEntry_t>::const_iterator it;
+    for (it = m_entries.lowerBound(prefix); it != m_entries.constEnd() && it.key().startsWith(prefix); ++it)
+    {
+        QString name = it.key().mid(prefix.length());
+        int slash = name.indexOf('/');
+        if (folders)
+        {
+            if (slash < 0)
+                continue;
+            name = name.left(slash);
+            if (!names.isEmpty() && names.last() == name)
+                continue;
+        }
+        else if (slash >= 0)
+            continue;
+        names.append(name);
+    }
+    return names;
+}
+
+bool CMusicArchive::readFile(const QString& path, vector<unsigned char>& data)
+{
+    data.clear();
+    QString name = entryName(path);
+    QMap<QString, zipEntry_t>::const_iterator it = m_entries.constFind(name);
+    if (name.isEmpty() || it == m_entries.constEnd())
+        return false;
+
+    const zipEntry_t& entry = it.value();
+    qint64 headerPos = entry.localHeaderOffset;
+    if (headerPos + ZIP_LOCAL_HEADER_LENGTH > m_mappedSize ||
+        readZipDWord(m_mappedData + headerPos) != ZIP_LOCAL_HEADER_SIGNATURE)
+    {
+        ppLogError("Bad zip entry %s", qPrintable(name));
+        return false;
+    }
+    // The local header has its own name and extra field lengths
+    qint64 dataPos = headerPos + ZIP_LOCAL_HEADER_LENGTH + readZipWord(m_mappedData + headerPos + 26) +
+                     readZipWord(m_mappedData + headerPos + 28);
+    if (dataPos + entry.compressedSize > m_mappedSize)
+    {
+        ppLogError("Bad zip entry %s", qPrintable(name));
+        return false;
+    }
+    const uchar* compressed = m_mappedData + dataPos;
+
+    if (entry.method == 0)
+    {
+        data.assign(compressed, compressed + entry.compressedSize);
+        return true;
+    }
+    if (entry.method != Z_DEFLATED)
+    {
+        ppLogError("Unsupported zip compression %d for %s", entry.method, qPrintable(name));
+        return false;
+    }
+
+    data.resize(entry.size);
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // A negative window size means raw deflate data without the zlib header
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+        return false;
+    stream.next_in = const_cast<Bytef*>(compressed);
+    stream.avail_in = entry.compressedSize;
+    stream.next_out = (data.size() > 0) ? &data[0] : 0;
+    stream.avail_out = static_cast<uInt>(data.size());
+    int result = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END || stream.total_out != entry.size)
+    {
+        ppLogError("Cannot inflate %s from the zip file", qPrintable(name));
+        data.clear();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,95 @@
+/*********************************************************************************/
+/*!
+@file           MusicArchive.h
+
+@brief          Reads the songs straight out of a zip file (BoosterMusicBooks.zip).
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __MUSIC_ARCHIVE_H__
+#define __MUSIC_ARCHIVE_H__
+
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QMap>
+#include <vector>
+
+using namespace std;
+
+/*!
+ * @brief   A zip file that is used as a folder of music books.
+ *
+ * A file in the zip is named by the path of the zip file followed by its name in the zip,
+ * for example "/usr/share/music/BoosterMusicBooks.zip/BoosterMusicBooks1/Booster Music/01-ClairDeLaLune.mid".
+ * Only the zip directory is read when the zip is opened, a file is inflated when it is read.
+ */
+class CMusicArchive
+{
+public:
+    CMusicArchive()
+    {
+        m_mappedData = 0;
+        m_mappedSize = 0;
+    }
+
+    ~CMusicArchive() { close(); }
+
+    bool open(const QString& zipFileName);
+    void close();
+    bool isOpen() { return m_mappedData != 0; }
+    // The absolute path of the zip file
+    QString fileName() { return m_zipFileName; }
+
+    // True if the path is inside this zip file (the file itself may not be there)
+    bool contains(const QString& path);
+    // True if there is a file with this path in the zip
+    bool exists(const QString& path);
+    // The names of the files (or of the folders) directly inside a folder of the zip
+    QStringList entryList(const QString& dirPath, bool folders);
+    // Inflates one file from the zip into data
+    bool readFile(const QString& path, vector<unsigned char>& data);
+
+    // Splits "<something>.zip/<name>" into the zip file name and the name in the zip
+    static bool splitPath(const QString& path, QString* zipFileName, QString* entryName);
+
+private:
+    typedef struct
+    {
+        quint32 localHeaderOffset;
+        quint32 compressedSize;
+        quint32 size;
+        quint16 method;     // 0 stored, 8 deflated
+    } zipEntry_t;
+
+    bool readDirectory();
+    QString entryName(const QString& path);
+
+    QString m_zipFileName;
+    QFile m_zipFile;
+    const uchar* m_mappedData;
+    qint64 m_mappedSize;
+    QMap<QString, zipEntry_t> m_entries;    // The files in the zip, sorted by their name in the zip
+};
+
+#endif // __MUSIC_ARCHIVE_H__
@@ -179,6 +179,7 @@ public:
     {
         m_midiInputQueue = new CQueue<CMidiEvent>(1000);
         m_slotQueue = new CQueue<CSlot>(200);
+        m_loopStartInputQueue = new CQueue<CMidiEvent>(1000);
         reset();
         m_displayChannel = 0;
     }
@@ -186,9 +187,23 @@ public:
     {
         delete m_midiInputQueue;
         delete m_slotQueue;
+        delete m_loopStartInputQueue;
     }
     void reset();
 
+    // Only the events waiting to be read are kept, so this must be done before any slots have been read
+    void saveLoopStart()
+    {
+        *m_loopStartInputQueue = *m_midiInputQueue;
+        m_loopStartFindChord = m_findScrollerChord;
+    }
+    void restoreLoopStart()
+    {
+        reset();
+        *m_midiInputQueue = *m_loopStartInputQueue;
+        m_findScrollerChord = m_loopStartFindChord;
+    }
+
     void setChannel(int channel) {m_displayChannel = channel;}
 
 
@@ -222,6 +237,8 @@ private:
     CSlot m_mergeSlots[2];
     int m_displayChannel;
     CFindChord m_findScrollerChord;
+    CQueue<CMidiEvent>* m_loopStartInputQueue;
+    CFindChord m_loopStartFindChord;
     CBar m_bar;
     CNoteState m_noteState[MAX_MIDI_NOTES];
     static bool m_cfg_displayCourtesyAccidentals;
@@ -0,0 +1,130 @@
+/*********************************************************************************/
+/*!
+@file           PianistNotes.cpp
+
+@brief          The notes the pianist has down, and the chords saved to play with them.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include "PianistNotes.h"
+
+void CPianistNotes::addPianistNote(whichPart_t part, CMidiEvent midiNote, bool good)
+{
+    CStavePos stavePos;
+
+    if ( midiNote.velocity() == -1 )
+        return;
+
+    int note = midiNote.note();
+
+    stavePos.notePos(part, note);
+
+    if (stavePos.getStaveIndex() >= MAX_STAVE_INDEX || stavePos.getStaveIndex() <= MIN_STAVE_INDEX )
+        return;
+
+    if (good == true)
+        m_goodChord.addNote(part, note);
+    else
+        m_badChord.addNote(part, note);
+
+    pianistNoteAdded(stavePos, note);
+}
+
+// returns true only if the note is in the bad note list
+bool CPianistNotes::removePianistNote(int note)
+{
+    pianistNoteRemoved(note);
+    m_goodChord.removeNote(note);
+    return m_badChord.removeNote(note);
+}
+
+// Counts the number of notes the pianist has down
+int CPianistNotes::pianistAllNotesDown()
+{
+    return m_goodChord.length() + m_badChord.length();
+}
+
+int CPianistNotes::pianistBadNotesDown()
+{
+
+    return m_badChord.length();
+}
+
+void CPianistNotes::clear()
+{
+    clearNotes();
+    pianistNotesCleared();
+}
+
+void CPianistNotes::clearNotes()
+{
+    m_goodChord.clear();
+    m_badChord.clear();
+    for (unsigned int i = 0; i < arraySize(m_savedChordLookUp); i++)
+        m_savedChordLookUp[i].pitchKey = 0;
+}
+
+void CPianistNotes::addSavedChord(CMidiEvent midiNote, CChord chord)
+{
+    int key = midiNote.note();
+
+    for (unsigned int i = 0; i < arraySize(m_savedChordLookUp); i++)
+    {
+        if (midiNote.type() == MIDI_NOTE_ON)
+        {
+            if (m_savedChordLookUp[i].pitchKey == 0 )
+            {
+                m_savedChordLookUp[i].pitchKey = key;
+                m_savedChordLookUp[i].savedNoteOffChord = chord;
+
+                return;
+            }
+        }
+        else if (midiNote.type() == MIDI_NOTE_OFF)
+        {
+            if (m_savedChordLookUp[i].pitchKey == key )
+            {
+                m_savedChordLookUp[i].pitchKey = 0;
+                return;
+            }
+        }
+    }
+    m_savedChordLookUp[0].savedNoteOffChord = chord;
+}
+
+CChord CPianistNotes::removeSavedChord(int key)
+{
+    unsigned int i;
+    for (i = 0; i < arraySize(m_savedChordLookUp); i++)
+    {
+        if (m_savedChordLookUp[i].pitchKey == key )
+        {
+            m_savedChordLookUp[i].pitchKey = 0;
+            return m_savedChordLookUp[i].savedNoteOffChord;
+        }
+    }
+    i--;
+    m_savedChordLookUp[i].savedNoteOffChord.clear();
+    return m_savedChordLookUp[i].savedNoteOffChord;
+
+}
@@ -0,0 +1,88 @@
+/*********************************************************************************/
+/*!
+@file           PianistNotes.h
+
+@brief          The notes the pianist has down, and the chords saved to play with them.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __PIANIST_NOTES_H__
+#define __PIANIST_NOTES_H__
+
+#include "Chord.h"
+#include "StavePosition.h"
+
+typedef struct {
+        int pitchKey;       // This used to fined the Saved note off;
+        CChord savedNoteOffChord;
+} savedNoteOffChord_t;
+
+/*!
+ * @brief   The keys the pianist is holding down, as the conductor sees them.
+ *
+ * The piano display derives from this and is told about each change through the pianistNote*()
+ * hooks, so the engine can also be run with no display at all.
+ */
+class CPianistNotes
+{
+public:
+    CPianistNotes()
+    {
+        m_rhythmTapping = false;
+        clearNotes();
+    }
+    virtual ~CPianistNotes() {}
+
+    void addPianistNote(whichPart_t part, CMidiEvent midiNote, bool good);
+    // returns true only if the note is in the bad note list
+    bool removePianistNote(int note);
+
+    int pianistAllNotesDown(); // Counts the number of notes the pianist has down
+    int pianistBadNotesDown();
+    void clear();
+
+    void addSavedChord(CMidiEvent midiNote, CChord chord);
+    CChord removeSavedChord(int key);
+
+    CChord getGoodChord() { return m_goodChord; }
+    CChord getBadChord() { return m_badChord; }
+
+    void setRhythmTapping(bool state) { m_rhythmTapping = state; }
+
+protected:
+    // Hooks for the display
+    virtual void pianistNoteAdded(CStavePos& stavePos, int note) {}
+    virtual void pianistNoteRemoved(int note) {}
+    virtual void pianistNotesCleared() {}
+
+    CChord m_goodChord;  // The coloured note lines that appear on the score when the pianist plays
+    CChord m_badChord;
+    bool m_rhythmTapping;
+
+private:
+    void clearNotes();
+
+    savedNoteOffChord_t m_savedChordLookUp[20];
+};
+
+#endif //__PIANIST_NOTES_H__
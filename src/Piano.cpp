@@ -213,29 +213,9 @@ void CPiano::addNoteNameItem(float posY, int pitch, int type)
     spaceNoteNames();
 }
 
-void CPiano::addPianistNote(whichPart_t part, CMidiEvent midiNote, bool good)
+void CPiano::pianistNoteAdded(CStavePos& stavePos, int note)
 {
-    CStavePos stavePos;
-    float posY;
-
-    if ( midiNote.velocity() == -1 )
-        return;
-
-    int note = midiNote.note();
-
-    stavePos.notePos(part, note);
-
-    if (stavePos.getStaveIndex() >= MAX_STAVE_INDEX || stavePos.getStaveIndex() <= MIN_STAVE_INDEX )
-        return;
-
-    if (good == true)
-        m_goodChord.addNote(part, note);
-    else
-        m_badChord.addNote(part, note);
-
-
-    posY = stavePos.getPosYAccidental();
-    addNoteNameItem(posY, note, 0);
+    addNoteNameItem(stavePos.getPosYAccidental(), note, 0);
 }
 
 void CPiano::removeNoteNameItem(int pitch)
@@ -256,37 +236,19 @@ void CPiano::removeNoteNameItem(int pitch)
     spaceNoteNames();
 }
 
-// returns true only if the note is in the bad note list
-bool CPiano::removePianistNote(int note)
+void CPiano::pianistNoteRemoved(int note)
 {
     removeNoteNameItem( note);
-    m_goodChord.removeNote(note);
-    return m_badChord.removeNote(note);
 }
+
 void CPiano::noteNameListClear()
 {
     m_noteNameListLength = 0;
 }
 
-// Counts the number of notes the pianist has down
-int CPiano::pianistAllNotesDown()
+void CPiano::pianistNotesCleared()
 {
-    return m_goodChord.length() + m_badChord.length();
-}
-
-int CPiano::pianistBadNotesDown()
-{
-
-    return m_badChord.length();
-}
-
-void CPiano::clear()
-{
-    m_goodChord.clear();
-    m_badChord.clear();
     noteNameListClear();
-    for (unsigned int i = 0; i < arraySize(m_savedChordLookUp); i++)
-        m_savedChordLookUp[i].pitchKey = 0;
 }
 
 void CPiano::drawPianoInput()
@@ -303,49 +265,3 @@ void CPiano::drawPianoInput()
     if (showNoteName)
         drawPianoInputNoteNames();
 }
-
-void CPiano::addSavedChord(CMidiEvent midiNote, CChord chord)
-{
-    int key = midiNote.note();
-
-    for (unsigned int i = 0; i < arraySize(m_savedChordLookUp); i++)
-    {
-        if (midiNote.type() == MIDI_NOTE_ON)
-        {
-            if (m_savedChordLookUp[i].pitchKey == 0 )
-            {
-                m_savedChordLookUp[i].pitchKey = key;
-                m_savedChordLookUp[i].savedNoteOffChord = chord;
-
-                return;
-            }
-        }
-        else if (midiNote.type() == MIDI_NOTE_OFF)
-        {
-            if (m_savedChordLookUp[i].pitchKey == key )
-            {
-                m_savedChordLookUp[i].pitchKey = 0;
-                return;
-            }
-        }
-    }
-    m_savedChordLookUp[0].savedNoteOffChord = chord;
-}
-
-CChord CPiano::removeSavedChord(int key)
-{
-    unsigned int i;
-    for (i = 0; i < arraySize(m_savedChordLookUp); i++)
-    {
-        if (m_savedChordLookUp[i].pitchKey == key )
-        {
-            m_savedChordLookUp[i].pitchKey = 0;
-            return m_savedChordLookUp[i].savedNoteOffChord;
-        }
-    }
-    i--;
-    m_savedChordLookUp[i].savedNoteOffChord.clear();
-    return m_savedChordLookUp[i].savedNoteOffChord;
-
-}
-
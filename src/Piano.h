@@ -31,6 +31,7 @@
 
 #include "Draw.h"
 #include "Chord.h"
+#include "PianistNotes.h"
 #include "Settings.h"
 
 
@@ -41,36 +42,21 @@ typedef struct {
         int pitch;
 } noteNameItem_t;
 
-typedef struct {
-        int pitchKey;       // This used to fined the Saved note off;
-        CChord savedNoteOffChord;
-} savedNoteOffChord_t;
-
-
-class CPiano : protected CDraw
+class CPiano : protected CDraw, public CPianistNotes
 {
 
 public:
     CPiano(CSettings* settings) : CDraw(settings)
     {
+        noteNameListClear();
     }
 
     void drawPianoInput();
 
-    void addPianistNote(whichPart_t part, CMidiEvent midiNote, bool good);
-    bool removePianistNote(int note);
-
-    int pianistAllNotesDown(); // Counts the number of notes the pianist has down
-    int pianistBadNotesDown();
-    void clear();
-
-    void addSavedChord(CMidiEvent midiNote, CChord chord);
-    CChord removeSavedChord(int key);
-
-    CChord getGoodChord() { return m_goodChord; }
-    CChord getBadChord() { return m_badChord; }
-
-    void setRhythmTapping(bool state) { m_rhythmTapping = state; }
+protected:
+    virtual void pianistNoteAdded(CStavePos& stavePos, int note);
+    virtual void pianistNoteRemoved(int note);
+    virtual void pianistNotesCleared();
 
 private:
     void spaceNoteBunch(unsigned int bottomIndex, unsigned int topIndex);
@@ -82,12 +68,7 @@ private:
     void noteNameListClear();
 
     noteNameItem_t  m_noteNameList[20];
-    savedNoteOffChord_t m_savedChordLookUp[20];
     unsigned int m_noteNameListLength;
-
-    CChord m_goodChord;  // The coloured note lines that appear on the score when the pianist plays
-    CChord m_badChord;
-    bool m_rhythmTapping;
 };
 
 #endif //__PIANO_H__
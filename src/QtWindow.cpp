@@ -109,9 +109,11 @@ QtWindow::QtWindow()
     mainLayout->addLayout(columnLayout);
 
     m_song->init2(m_score, m_settings);
+    // Keep the song cache next to the settings file
+    m_song->setSongCacheDir(QFileInfo(m_settings->fileName()).absolutePath() + "/songcache");
 
-    m_sidePanel->init(m_song, m_song->getTrackList(), m_topBar);
-    m_topBar->init(m_song, m_song->getTrackList());
+    m_sidePanel->init(m_song, m_glWidget->getTrackList(), m_topBar);
+    m_topBar->init(m_song, m_glWidget->getTrackList());
 
     QWidget *centralWin = new QWidget();
     centralWin->setLayout(mainLayout);
@@ -184,6 +186,11 @@ void QtWindow::displayUsage()
     fprintf(stderr, "      --Xnote-length      Displays the note length (experimental)\n");
     fprintf(stderr, "      --Xtick-rate=RATE   Adjust the tick rate in mSec (experimental).\n");
     fprintf(stderr, "                          default 4 (12 windows).\n");
+    fprintf(stderr, "      --Xstream=BEATS     Decode very long songs as they play (experimental).\n");
+    fprintf(stderr, "                          Looks ahead BEATS quarter notes for each note off.\n");
+    fprintf(stderr, "      --Xlook-ahead=MSEC  Schedule the notes MSEC milliseconds ahead when listening\n");
+    fprintf(stderr, "                          or playing along, so they sound on time.\n");
+    fprintf(stderr, "                          default 30, 0 sends them as they are reached.\n");
     fprintf(stderr, "  -h, --help              Displays this help message.\n");
     fprintf(stderr, "  -v, --version           Displays version number and then exits.\n");
     fprintf(stderr, "  -l   --log              Write debug info to the \"pb.log\" log file.\n");
@@ -288,6 +295,14 @@ void QtWindow::decodeCommandLine()
                 if (validateIntegerParamWithMessage(arg)) {
                     Cfg::tickRate = decodeIntegerParam(arg, 12);
                 }
+            } else if (arg.startsWith("--Xstream")) {
+                if (validateIntegerParamWithMessage(arg)) {
+                    Cfg::streamingHorizon = decodeIntegerParam(arg, 16);
+                }
+            } else if (arg.startsWith("--Xlook-ahead")) {
+                if (validateIntegerParamWithMessage(arg)) {
+                    Cfg::outputLookAhead = decodeIntegerParam(arg, 30);
+                }
             } else if (arg.startsWith("-l") || arg.startsWith("--log"))
                 Cfg::useLogFile = true;
             else if (arg.startsWith("--midi-input-dump"))
@@ -729,3 +744,10 @@ void QtWindow::loadTutorHtml(const QString & name)
 
 }
 
+void QtWindow::loadTutorText(const QString & html)
+{
+    m_tutorWindow->setHtml(html);
+    m_tutorWindow->setFixedHeight(104);
+    m_tutorWindow->show();
+}
+
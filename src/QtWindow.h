@@ -67,6 +67,8 @@ public:
     }
 
     void loadTutorHtml(const QString & name);
+    // Shows a tutor page that has been read from the music zip file
+    void loadTutorText(const QString & html);
     void setCurrentFile(const QString &fileName);
 
 private slots:
@@ -94,7 +96,7 @@ private slots:
     void showSongDetailsDialog()
     {
         GuiSongDetailsDialog songDetailsDialog(this);
-        songDetailsDialog.init(m_song, m_settings);
+        songDetailsDialog.init(m_song, m_settings, m_glWidget);
         songDetailsDialog.exec();
     }
 
@@ -30,11 +30,17 @@
 #define __QUEUE_H__
 
 #include <assert.h>
+#include <atomic>
 
-// A Queue or circular buffer also also call a FIFO a First In First Out buffer
-// different threads could be running each end of the queue
+#define QUEUE_CACHE_LINE    64
 
+// A Queue or circular buffer also also call a FIFO a First In First Out buffer
 //
+// One thread can push() while another thread pops(), but there must only be one thread at each end.
+// The producer only writes m_head and the consumer only writes m_tail, the release store of an index
+// publishes the items before it to the other end. The two indexes are on their own cache lines so
+// the two ends don't keep taking the line away from each other.
+// clear(), the copy and length() at the push end are only exact when there is just the one thread.
 template <class TYPE>
 
 class CQueue
@@ -42,84 +48,171 @@ class CQueue
 public:
     explicit CQueue(int size)
     {
-        m_size = size;
-        m_buffer = new TYPE[size];
+        allocate(size);
         clear();
     }
 
+    // A copy has its own buffer (used to keep a snapshot of a queue)
+    CQueue(const CQueue<TYPE>& other)
+    {
+        allocate(other.m_size);
+        *this = other;
+    }
+
     ~CQueue()
     {
         delete [] m_buffer;
     }
 
+    CQueue<TYPE>& operator=(const CQueue<TYPE>& other)
+    {
+        if (this == &other)
+            return *this;
+        if (m_size != other.m_size)
+        {
+            delete [] m_buffer;
+            allocate(other.m_size);
+        }
+        // Only the items in the queue are copied
+        unsigned int tail = other.m_tail.load(std::memory_order_acquire);
+        unsigned int head = other.m_head.load(std::memory_order_acquire);
+        for (unsigned int i = tail; i != head; i++)
+            m_buffer[i & m_mask] = other.m_buffer[i & m_mask];
+        m_head.store(head, std::memory_order_relaxed);
+        m_tail.store(tail, std::memory_order_relaxed);
+        m_cachedHead = head;
+        m_cachedTail = tail;
+        return *this;
+    }
+
     void clear()
     {
-        m_count = m_head = m_tail=0;
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_cachedHead = 0;
+        m_cachedTail = 0;
     }
 
     // pushes the item into the queue and returns a pointer to the item in the buffer
     TYPE* push(TYPE c)
     {
-        if (!space())
+        unsigned int head = m_head.load(std::memory_order_relaxed);
+        if (!pushSpace(head, 1))
         {
             assert(false);
             return 0;
         }
-        TYPE* itemPtr = &m_buffer[m_head];
-        m_buffer[m_head] = c;
-        m_head++;
-        if (m_head >= m_size)
-            m_head = 0;
-
-        // This must be last if a different thread is using pop()
-        m_count++;
+        TYPE* itemPtr = &m_buffer[head & m_mask];
+        *itemPtr = c;
+        m_head.store(head + 1, std::memory_order_release);
         return itemPtr;
     }
 
+    // Pushes as many of the items as there is space for, returns the number pushed
+    int push(const TYPE* items, int count)
+    {
+        unsigned int head = m_head.load(std::memory_order_relaxed);
+        if (count <= 0)
+            return 0;
+        if (!pushSpace(head, count))
+            count = m_size - static_cast<int>(head - m_cachedTail);
+        for (int i = 0; i < count; i++)
+            m_buffer[(head + i) & m_mask] = items[i];
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
     TYPE pop()
     {
-        TYPE c;
-        if (!length())
+        unsigned int tail = m_tail.load(std::memory_order_relaxed);
+        if (!popLength(tail, 1))
         {
             assert(false);
-            return m_buffer[m_tail];
+            return m_buffer[tail & m_mask];
         }
-        c = m_buffer[m_tail++];
-        if (m_tail >= m_size)
-            m_tail = 0;
-
-        // This must be last if a different thread is using push()
-        m_count--;
+        TYPE c = m_buffer[tail & m_mask];
+        m_tail.store(tail + 1, std::memory_order_release);
         return c;
     }
 
-    // returns a pointer to the item starting at the end of the queue
+    // Pops up to maxCount items, returns the number popped
+    int pop(TYPE* items, int maxCount)
+    {
+        unsigned int tail = m_tail.load(std::memory_order_relaxed);
+        if (maxCount <= 0)
+            return 0;
+        int count = maxCount;
+        if (!popLength(tail, count))
+            count = static_cast<int>(m_cachedHead - tail);
+        for (int i = 0; i < count; i++)
+            items[i] = m_buffer[(tail + i) & m_mask];
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    // returns a pointer to the item starting at the end of the queue (only used at the pop end)
     TYPE * indexPtr(int index)
     {
-        int offset;
-        if (index >= length())
+        unsigned int tail = m_tail.load(std::memory_order_relaxed);
+        if (index < 0 || !popLength(tail, index + 1))
         {
             assert(false);
-            return &m_buffer[m_head];
+            return &m_buffer[m_head.load(std::memory_order_relaxed) & m_mask];
         }
-        offset = m_tail + index;
-        if (offset >= m_size)
-            offset -= m_size;
-        return &m_buffer[offset];
+        return &m_buffer[(tail + index) & m_mask];
     }
 
     TYPE index(int index){ return *indexPtr(index);}
 
-    int length() {return m_count;}
-    int space() {return m_size - m_count;}
+    int length()
+    {
+        unsigned int tail = m_tail.load(std::memory_order_acquire);
+        return static_cast<int>(m_head.load(std::memory_order_acquire) - tail);
+    }
+    int space() {return m_size - length();}
+
 private:
+    // The buffer is a power of two long so the indexes can just keep counting up and be masked
+    void allocate(int size)
+    {
+        m_size = 1;
+        while (m_size < size)
+            m_size *= 2;
+        m_mask = m_size - 1;
+        m_buffer = new TYPE[m_size];
+    }
+
+    // Only called at the push end, the consumer's tail is only read again when the queue looks full
+    bool pushSpace(unsigned int head, int count)
+    {
+        if (static_cast<int>(head - m_cachedTail) + count <= m_size)
+            return true;
+        m_cachedTail = m_tail.load(std::memory_order_acquire);
+        return (static_cast<int>(head - m_cachedTail) + count <= m_size);
+    }
+
+    // Only called at the pop end
+    bool popLength(unsigned int tail, int count)
+    {
+        if (static_cast<int>(m_cachedHead - tail) >= count)
+            return true;
+        m_cachedHead = m_head.load(std::memory_order_acquire);
+        return (static_cast<int>(m_cachedHead - tail) >= count);
+    }
+
     TYPE * m_buffer;
     int m_size;
-    int m_head;
-    int m_tail;
+    unsigned int m_mask;
+
+    char m_padding1[QUEUE_CACHE_LINE];
+    std::atomic<unsigned int> m_head;   // Only written by the push end
+    unsigned int m_cachedTail;          // The push end's last look at m_tail
+
+    char m_padding2[QUEUE_CACHE_LINE];
+    std::atomic<unsigned int> m_tail;   // Only written by the pop end
+    unsigned int m_cachedHead;          // The pop end's last look at m_head
 
-    // this should be atomic operation when two different threads are at each end of the queue
-    volatile int m_count;
+    char m_padding3[QUEUE_CACHE_LINE];
 };
 
 #endif //__QUEUE_H__
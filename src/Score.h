@@ -34,9 +34,10 @@
 #include "Scroll.h"
 #include "Piano.h"
 #include "Settings.h"
+#include "ConductorObserver.h"
 
 
-class CScore : public CDraw
+class CScore : public CDraw, public CScoreObserver
 {
 public:
 
@@ -83,6 +84,18 @@ public:
             m_scroll[i]->reset();
     }
 
+    void saveLoopStart()
+    {   size_t i;
+        for (i=0; i< arraySize(m_scroll); i++)
+            m_scroll[i]->saveLoopStart();
+    }
+
+    void restoreLoopStart()
+    {   size_t i;
+        for (i=0; i< arraySize(m_scroll); i++)
+            m_scroll[i]->restoreLoopStart();
+    }
+
     void drawScrollingSymbols(bool show = true)
     {   size_t i;
         for (i=0; i< arraySize(m_scroll); i++)
@@ -32,6 +32,7 @@
 
 #include "Draw.h"
 #include "Song.h"
+#include "Notation.h"
 #include "Queue.h"
 
 #define QUEUE_LENGTH    1000
@@ -61,6 +62,12 @@ public:
         delete m_notation;
     }
     void reset();
+    void saveLoopStart() { m_notation->saveLoopStart(); }
+    void restoreLoopStart()
+    {
+        reset();
+        m_notation->restoreLoopStart();
+    }
     void scrollDeltaTime(int ticks);
     void transpose(int transpose);
     void refresh();
@@ -43,6 +43,7 @@
 
 #include <QTextStream>
 #include <QFile>
+#include <QMessageBox>
 #include "Settings.h"
 #include "GuiTopBar.h"
 #include "GuiSidePanel.h"
@@ -68,6 +69,8 @@ CSettings::CSettings(QtWindow *mainWindow) : QSettings(CSettings::IniFormat, CSe
     m_noteNamesEnabled = value("Score/NoteNames", true ).toBool();
     m_tutorPagesEnabled = value("Tutor/TutorPages", true ).toBool();
     CNotation::setCourtesyAccidentals(value("Score/CourtesyAccidentals", false ).toBool());
+    // Keep the song index next to the settings file
+    m_songIndex.setIndexFile(QFileInfo(fileName()).absolutePath() + "/songindex.dat");
 }
 
 void CSettings::setDefaultValue(const QString & key, const QVariant & value )
@@ -211,7 +214,7 @@ void CSettings::loadXmlFile()
     m_domSong.clear();
     m_domHand.clear();
 
-    QFile file(m_bookPath + getCurrentBookName() + '/' + "pb.cfg");
+    QFile file(bookConfigFileName());
     if (file.open(QIODevice::ReadOnly))
     {
         if (!m_domDocument.setContent(&file)) {
@@ -233,6 +236,16 @@ void CSettings::loadXmlFile()
     loadBookSettings();
 }
 
+// The book settings are kept in the book's folder, but a book in the music zip file
+// has them in a folder next to the settings file instead
+QString CSettings::bookConfigFileName()
+{
+    if (m_musicArchive.contains(m_bookPath))
+        return QFileInfo(fileName()).absolutePath() + '/' + QFileInfo(m_musicArchive.fileName()).completeBaseName() +
+               '/' + getCurrentBookName() + '/' + "pb.cfg";
+    return m_bookPath + getCurrentBookName() + '/' + "pb.cfg";
+}
+
 // save the xml
 void CSettings::saveXmlFile()
 {
@@ -240,7 +253,7 @@ void CSettings::saveXmlFile()
 
     const int IndentSize = 4;
 
-    QFile file(m_bookPath + getCurrentBookName() + '/' + "pb.cfg");
+    QFile file(bookConfigFileName());
 
     // don't save the config file unless the user really is using the system
     if (m_pianistActive == false && file.exists() == false)
@@ -248,6 +261,7 @@ void CSettings::saveXmlFile()
 
     m_pianistActive = false;
 
+    QDir().mkpath(QFileInfo(file).absolutePath());
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
     {
         ppLogError("Cannot save xml file %s", qPrintable(file.fileName()));
@@ -259,6 +273,25 @@ void CSettings::saveXmlFile()
     file.close();
 }
 
+// Shows the tutor page if it exists, the page may be in the music zip file
+bool CSettings::showTutorPage(const QString & fileName)
+{
+    if (m_musicArchive.contains(fileName))
+    {
+        vector<unsigned char> html;
+        if (!m_musicArchive.readFile(fileName, html) || html.size() == 0)
+            return false;
+        m_mainWindow->loadTutorText(QString::fromUtf8(reinterpret_cast<const char*>(&html[0]), static_cast<int>(html.size())));
+        return true;
+    }
+
+    QFileInfo tutorFile(fileName);
+    if (!tutorFile.exists())
+        return false;
+    m_mainWindow->loadTutorHtml(tutorFile.absoluteFilePath());
+    return true;
+}
+
 void CSettings::updateTutorPage()
 {
     QFileInfo fileInfo(getCurrentSongLongFileName());
@@ -270,33 +303,20 @@ void CSettings::updateTutorPage()
 
     if (m_tutorPagesEnabled)
     {
-		QFileInfo tutorFile;
- 		tutorFile.setFile(fileBase + locale + EXTN);
-        if (tutorFile.exists())
-        {
-            m_mainWindow->loadTutorHtml(tutorFile.absoluteFilePath());
+        if (showTutorPage(fileBase + locale + EXTN))
             return;
-        }
         int n = locale.indexOf("_");
 
         if (n > 0)
         {
             locale = locale.left(n);
- 			tutorFile.setFile(fileBase + locale + EXTN);
-            if (tutorFile.exists())
-            {
-                m_mainWindow->loadTutorHtml(tutorFile.absoluteFilePath());
+            if (showTutorPage(fileBase + locale + EXTN))
                 return;
-            }
         }
 
         locale = "en";
- 		tutorFile.setFile(fileBase + locale + EXTN);
-        if (tutorFile.exists())
-        {
-            m_mainWindow->loadTutorHtml(tutorFile.absoluteFilePath());
+        if (showTutorPage(fileBase + locale + EXTN))
             return;
-        }
     }
     m_mainWindow->loadTutorHtml(QString());
 
@@ -304,14 +324,23 @@ void CSettings::updateTutorPage()
 
 void CSettings::openSongFile(const QString & filename)
 {
-    if (!QFile::exists(filename))
+    bool inArchive = m_musicArchive.exists(filename);
+    if (!inArchive && !QFile::exists(filename))
     {
         ppLogError( "File does not exists %s", qPrintable(filename));
         return;
     }
     QDir dirBooks;
     QString  currentSongName;
-    if (filename.isEmpty())
+    if (inArchive)
+    {
+        // QDir cannot walk up the folders inside the zip file
+        QString path = QDir::fromNativeSeparators(filename);
+        currentSongName = path.section('/', -1);
+        m_currentBookName = path.section('/', -2, -2);
+        dirBooks.setPath(path.section('/', 0, -3));
+    }
+    else if (filename.isEmpty())
     {
         dirBooks.setPath( QDir::homePath());
     }
@@ -324,6 +353,7 @@ void CSettings::openSongFile(const QString & filename)
         dirBooks.cdUp();
     }
     m_bookPath =  dirBooks.path() + '/';
+    m_songIndex.startIndexing(m_bookPath);
 
     m_currentSongName = currentSongName;
     m_guiSidePanel->loadBookList();
@@ -340,9 +370,20 @@ void CSettings::setActiveHand(whichPart_t hand)
 QStringList CSettings::getSongList()
 {
     debugSettings(("getSongList %s + %s", qPrintable(getCurrentBookName()), qPrintable(m_bookPath)));
-    QDir dirSongs = QDir(m_bookPath + getCurrentBookName());
-    dirSongs.setFilter(QDir::Files);
-    QStringList fileNames = dirSongs.entryList();
+    QStringList fileNames;
+    // The index has the songs in the book unless the book has changed since it was indexed
+    if (m_songIndex.getSongList(m_bookPath + getCurrentBookName(), &fileNames))
+        return fileNames;
+    m_songIndex.startIndexing(m_bookPath);
+
+    if (m_musicArchive.contains(m_bookPath))
+        fileNames = m_musicArchive.entryList(m_bookPath + getCurrentBookName(), false);
+    else
+    {
+        QDir dirSongs = QDir(m_bookPath + getCurrentBookName());
+        dirSongs.setFilter(QDir::Files);
+        fileNames = dirSongs.entryList();
+    }
 
 
     QStringList songNames;
@@ -359,8 +400,22 @@ QStringList CSettings::getSongList()
     return songNames;
 }
 
+bool CSettings::getSongInfo(const QString & songName, songInfo_t* info)
+{
+    return m_songIndex.getSongInfo(m_bookPath + getCurrentBookName(), songName, info);
+}
+
 QStringList CSettings::getBookList()
 {
+    QStringList bookNames;
+    // The index has the books in the book path unless a book has been added or removed since it was indexed
+    if (m_songIndex.getBookList(m_bookPath, &bookNames))
+        return bookNames;
+    m_songIndex.startIndexing(m_bookPath);
+
+    // The books in the music zip file are listed from the zip's directory
+    if (m_musicArchive.contains(m_bookPath))
+        return m_musicArchive.entryList(m_bookPath, true);
     QDir dirBooks( m_bookPath);
     dirBooks.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
     return dirBooks.entryList();
@@ -370,7 +425,7 @@ QStringList CSettings::getBookList()
 void CSettings::writeSettings()
 {
 
-    if (QFile::exists(getCurrentSongLongFileName() ))
+    if (QFile::exists(getCurrentSongLongFileName() ) || m_musicArchive.exists(getCurrentSongLongFileName()))
         setValue("CurrentSong", getCurrentSongLongFileName());
     saveXmlFile();
 }
@@ -378,7 +433,7 @@ void CSettings::writeSettings()
 
 void CSettings::loadSettings()
 {
-    unzipBootserMusicBooks();
+    openBoosterMusicBooks();
     // Set default values
     setValue("PianoBooster/Version", PB_VERSION);
     setDefaultValue("ShortCuts/LeftHand", "F2");
@@ -401,94 +456,55 @@ void CSettings::loadSettings()
 
 }
 
-void CSettings::unzipBootserMusicBooks()
+void CSettings::openBoosterMusicBooks()
 {
-    // Set default values
-
     const int MUSIC_RELEASE = 1;
     const QString ZIPFILENAME("BoosterMusicBooks.zip");
 
+    QString resourceDir = QApplication::applicationDirPath() + "/../music/";
 
-    if (value("PianoBooster/MusicRelease", 0).toInt() < MUSIC_RELEASE)
-    {
-        QString resourceDir = QApplication::applicationDirPath() + "/../music/";
-
-        ppLogTrace("resourceDir1 %s", qPrintable(resourceDir));
+    ppLogTrace("resourceDir1 %s", qPrintable(resourceDir));
 
-        if (!QFile::exists(resourceDir + ZIPFILENAME))
-            resourceDir = QApplication::applicationDirPath() + "/../../music/";
-        ppLogTrace("resourceDir2 %s", qPrintable(resourceDir));
+    if (!QFile::exists(resourceDir + ZIPFILENAME))
+        resourceDir = QApplication::applicationDirPath() + "/../../music/";
+    ppLogTrace("resourceDir2 %s", qPrintable(resourceDir));
 
-        if (!QFile::exists(resourceDir + ZIPFILENAME))
-        {
+    if (!QFile::exists(resourceDir + ZIPFILENAME))
+    {
 #ifdef Q_OS_LINUX
-            resourceDir = QApplication::applicationDirPath() + "/../share/games/" + QSTR_APPNAME + "/music/";
+        resourceDir = QApplication::applicationDirPath() + "/../share/games/" + QSTR_APPNAME + "/music/";
 #endif
 #ifdef Q_OS_DARWIN
-            resourceDir = QApplication::applicationDirPath() + "/../Resources/music/";
+        resourceDir = QApplication::applicationDirPath() + "/../Resources/music/";
 #endif
-        }
-
-        ppLogInfo(qPrintable("applicationDirPath=" + QApplication::applicationDirPath()));
-        ppLogTrace("resourceDir3 %s", qPrintable(resourceDir));
+    }
 
+    ppLogInfo(qPrintable("applicationDirPath=" + QApplication::applicationDirPath()));
+    ppLogTrace("resourceDir3 %s", qPrintable(resourceDir));
 
-        QFileInfo zipFile(resourceDir +  ZIPFILENAME);
-        ppLogTrace("xx %s", qPrintable(zipFile.filePath()));
-        
-		QDir destMusicDir;
-		
+    // The songs are read straight out of the zip file, so it is not unzipped any more
+    QString musicDir;
+    if (m_musicArchive.open(resourceDir + ZIPFILENAME))
+        musicDir = m_musicArchive.fileName();
+    else
+    {
 #ifdef _WIN32
-        const QString MUSIC_DIR_NAME("My Music");
-		QSettings settings(QSettings::UserScope, "Microsoft", "Windows");
-		settings.beginGroup("CurrentVersion/Explorer/Shell Folders");
-		destMusicDir.setPath(QDir::fromNativeSeparators(settings.value("Personal").toString()));
+        // on windows the the installer does the unzipping
+        QSettings settings(QSettings::UserScope, "Microsoft", "Windows");
+        settings.beginGroup("CurrentVersion/Explorer/Shell Folders");
+        musicDir = QDir::fromNativeSeparators(settings.value("Personal").toString()) + "/My Music";
 #else
-        const QString MUSIC_DIR_NAME("Music");
-		destMusicDir.setPath(QDir::homePath() );
+        ppLogError(qPrintable("Cannot find " + ZIPFILENAME));
+        return;
 #endif
-         
-        if (!QDir(destMusicDir.absolutePath() + "/" + MUSIC_DIR_NAME).exists())
-        {
-            destMusicDir.mkdir(MUSIC_DIR_NAME);
-        }
-        destMusicDir.setPath(destMusicDir.absolutePath() + "/" + MUSIC_DIR_NAME);
-
-#ifndef _WIN32
-
-		// on windows the the installer does the unzipping
-        if (!zipFile.exists() )
-        {
-            ppLogError(qPrintable("Cannot find " + ZIPFILENAME));
-            return;
-        }
-
-
-
-        QProcess unzip;
-        unzip.start("unzip", QStringList() << "-o" << zipFile.filePath() << "-d" << destMusicDir.path() );
-        ppLogInfo(qPrintable("running unzip -o " + zipFile.filePath() + " -d " + destMusicDir.path()) );
-        char buf[1024];
-        while (true)
-        {
-            qint64 lineLength = unzip.readLine(buf, sizeof(buf));
-            if (lineLength <= 0)
-                break;
-            ppLogInfo(buf);
-                 // the line is available in buf
-        }
-
+    }
 
-        if (!unzip.waitForFinished())
-        {
-             ppLogError("unzip failed");
-             return;
-        }
-#endif       
-		QString fileName(destMusicDir.absolutePath() + "/BoosterMusicBooks" + QString::number(MUSIC_RELEASE) + "/Booster Music/01-ClairDeLaLune.mid");
-		openSongFile(fileName);
-		m_mainWindow->setCurrentFile(fileName);
-		setValue("PianoBooster/MusicRelease", MUSIC_RELEASE);
+    if (value("PianoBooster/MusicRelease", 0).toInt() < MUSIC_RELEASE)
+    {
+        QString fileName(musicDir + "/BoosterMusicBooks" + QString::number(MUSIC_RELEASE) + "/Booster Music/01-ClairDeLaLune.mid");
+        openSongFile(fileName);
+        m_mainWindow->setCurrentFile(fileName);
+        setValue("PianoBooster/MusicRelease", MUSIC_RELEASE);
     }
 }
 
@@ -502,6 +518,12 @@ void CSettings::setCurrentSongName(const QString & name)
     setValue("CurrentSong", getCurrentSongLongFileName());
 
     m_song->loadSong(getCurrentSongLongFileName());
+    if (m_song->getMidiError() == SMF_CANNOT_OPEN_FILE)
+        QMessageBox::warning(0, QMessageBox::tr("Midi File Error"),
+                 QMessageBox::tr("Cannot open \"") + getCurrentSongLongFileName() + "\"");
+    else if (m_song->getMidiError() != SMF_NO_ERROR)
+        QMessageBox::warning(0, QMessageBox::tr("Midi File Error"),
+                 QMessageBox::tr("Midi file\"") + getCurrentSongLongFileName() + QMessageBox::tr("\" is corrupted"));
     loadSongSettings();
 
     m_guiSidePanel->refresh();
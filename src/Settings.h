@@ -31,6 +31,8 @@
 #include <QDomDocument>
 #include "Song.h"
 #include "Notation.h"
+#include "MusicArchive.h"
+#include "SongIndex.h"
 
 #define QSTR_APPNAME "pianobooster"
 
@@ -39,7 +41,7 @@ class GuiTopBar;
 class QtWindow;
 
 /// Save all the settings for the programme in the right place.
-class CSettings : public QSettings
+class CSettings : public QSettings, public CSettingsObserver
 {
 
 public:
@@ -74,9 +76,11 @@ public:
     void setCurrentBookName(const QString & name, bool clearSongName);
     QStringList getBookList();
     QStringList getSongList();
+    // What the song index knows about a song in the current book
+    bool getSongInfo(const QString & songName, songInfo_t* info);
     void writeSettings();
     void loadSettings();
-    void unzipBootserMusicBooks();
+    void openBoosterMusicBooks();
     QString getCurrentSongLongFileName()
     {
         if (getCurrentSongName().isEmpty())
@@ -118,6 +122,8 @@ private:
     void saveBookSettings();
     void loadXmlFile();
     void saveXmlFile();
+    QString bookConfigFileName();
+    bool showTutorPage(const QString & fileName);
     void setDefaultValue(const QString & key, const QVariant & value );
 
 
@@ -149,6 +155,8 @@ private:
     QString m_currentSongName;
     QString m_warningMessage;
     QStringList m_fluidSoundFontNames;
+    CMusicArchive m_musicArchive;   // BoosterMusicBooks.zip
+    CSongIndex m_songIndex;
     bool m_pianistActive;
 };
 
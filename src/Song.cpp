@@ -27,10 +27,10 @@
 /*********************************************************************************/
 
 #include "Song.h"
-#include "Score.h"
+#include "MidiDeviceVirtual.h"
 
 
-void CSong::init2(CScore * scoreWin, CSettings* settings)
+void CSong::init2(CScoreObserver * scoreWin, CSettingsObserver* settings)
 {
 
     CNote::setChannelHands(-2, -2);  // -2 for not set -1 for none
@@ -57,10 +57,15 @@ void CSong::loadSong(const QString & filename)
      fn = fn.replace('/','\\');
 #endif
     m_midiFile->setLogLevel(3);
+    m_midiFile->setStreamingHorizon(Cfg::streamingHorizon);
+    clearSongInfo();
+    // The song info is collected by examineMidiEvent() while the file is being opened
     m_midiFile->openMidiFile(string(fn.toLocal8Bit().data()));
     ppLogInfo("Opening song %s",  fn.toLocal8Bit().data());
+    if (m_midiFile->getKeySignature() != NO_KEY_SIGNATURE)
+        CStavePos::setKeySignature(m_midiFile->getKeySignature(), m_midiFile->getMajorKey());
+    buildChordLists();
     transpose(0);
-    midiFileInfo();
     m_midiFile->setLogLevel(99);
     playMusic(false);
     rewind();
@@ -73,27 +78,31 @@ void CSong::loadSong(const QString & filename)
 }
 
 
-// read the file ahead to collect info about the song first
-void CSong::midiFileInfo()
+void CSong::clearSongInfo()
 {
-    m_trackList->clear();
+    m_trackAnalysis->clear();
+    getTempoMap()->clear();
+    getBarIndex()->clear();
+    m_haveLoopStart = false;
+    for (int chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+        m_chordLists[chan] = CChordList();
+    m_pianoPartChordList = CChordList();
+    m_chordList = 0;
     setTimeSig(0,0);
     CStavePos::setKeySignature( NOT_USED, 0 );
+}
 
-    // Read the next events to find the active channels
-    CMidiEvent event;
-    while ( true )
-    {
-        event = m_midiFile->readMidiEvent();
-        m_trackList->examineMidiEvent(event);
-
-        if (event.type() == MIDI_PB_timeSignature)
-        {
-            setTimeSig(event.data1(),event.data2());
-        }
+// Called by the midi file for every event in the song to collect info about the song first
+void CSong::examineMidiEvent(CMidiEvent event)
+{
+    // find the active channels
+    m_trackAnalysis->examineMidiEvent(event);
+    getTempoMap()->examineMidiEvent(event);
+    getBarIndex()->examineMidiEvent(event);
 
-        if (event.type() == MIDI_PB_EOF)
-            break;
+    if (event.type() == MIDI_PB_timeSignature)
+    {
+        setTimeSig(event.data1(),event.data2());
     }
 }
 
@@ -141,9 +150,30 @@ void CSong::regenerateChordQueue()
 
     m_wantedChordQueue->clear();
     m_findChord.reset();
+    // The chords saved at the start of the loop may be for a different channel
+    m_haveLoopStart = false;
 
     length = m_songEventQueue->length();
 
+    // The hands may have been given to different channels since the piano part was last found
+    int chan = getActiveChannel();
+    if (m_midiFile->getSongEvents() != 0 && CNote::hasPianoPart(chan) && !m_pianoPartChordList.isFor(chan))
+        m_pianoPartChordList.build(m_midiFile->getSongEvents(), m_midiFile->getSongEventCount(), chan);
+    m_chordList = 0;
+    CChordList* chordList = getChordList();
+    if (chordList != 0)
+    {
+        // The chords are timed from the event before the first one in the queue
+        int tick = m_readTick;
+        for (i = 0; i < length; i++)
+            tick -= m_songEventQueue->index(i).deltaTime();
+        m_chordTick = m_nextChordTick = tick;
+        m_nextChord = chordList->findChord(tick);
+        insertChords(chordList, m_midiFile->getEventIndex());
+        resetWantedChord();
+        return;
+    }
+
     for (i = 0; i < length; i++)
     {
         event = m_songEventQueue->index(i);
@@ -155,16 +185,157 @@ void CSong::regenerateChordQueue()
     resetWantedChord();
 }
 
+// Finds the chords for each channel once the song has been loaded, as no hands are set yet
+// the notes are split at middle C. The piano part is found when the hands are set.
+void CSong::buildChordLists()
+{
+    const CMidiEvent* events = m_midiFile->getSongEvents();
+    if (events == 0)
+        return; // a streamed song is not all in memory
+
+    for (int chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+        m_chordLists[chan].build(events, m_midiFile->getSongEventCount(), chan);
+}
+
+// Selects the chords for the active channel, nothing is built here as it is called by task()
+CChordList* CSong::getChordList()
+{
+    int chan = getActiveChannel();
+    CChordList* chordList = 0;
+
+    if (m_midiFile->getSongEvents() == 0 || chan < 0 || chan >= MAX_MIDI_CHANNELS)
+        chordList = 0;
+    else if (CNote::hasPianoPart(chan) == false)
+        chordList = &m_chordLists[chan]; // The other channels do not change the hands used
+    else if (m_pianoPartChordList.isFor(chan))
+        chordList = &m_pianoPartChordList;
+    // else the hands have changed and the piano part has not been found yet
+
+    if (chordList != 0 && chordList != m_chordList)
+        m_nextChord = chordList->findChord(m_nextChordTick);
+    m_chordList = chordList;
+    return chordList;
+}
+
+// Gives the conductor the chords that are complete once the first eventCount song events have been read
+void CSong::insertChords(CChordList* chordList, size_t eventCount)
+{
+    while (m_nextChord < chordList->size() && chordList->getEventIndex(m_nextChord) < eventCount)
+    {
+        CChord chord = chordList->getChord(m_nextChord);
+        int tick = chordList->getTick(m_nextChord);
+        chord.setDeltaTime(tick - m_chordTick);
+        chordEventInsert(chord);
+        m_chordTick = tick;
+        m_nextChordTick = tick + 1;
+        m_nextChord++;
+    }
+}
+
 void CSong::refreshScroll()
 {
     m_scoreWin->refreshScroll();
     forceScoreRedraw();
 }
 
-eventBits_t CSong::task(int ticks)
+// Skips all the events before the play from bar instead of playing through them
+void CSong::jumpToStartBar()
+{
+    barIndexEntry_t bar;
+    int barNumber = static_cast<int>(getPlayFromBar());
+
+    if (barNumber <= 0 || getBarIndex()->findBar(barNumber, &bar) == false)
+        return;
+
+    // Throw away any events that have already been read
+    rewind();
+
+    if (m_midiFile->seekToEvent(bar.eventIndex) == false)
+    {
+        // A streamed song has to be read up to the bar
+        for (int i = 0; i < bar.eventIndex; i++)
+            m_midiFile->readMidiEvent();
+    }
+    // A loop that starts on a bar can go back to this point without reading the song again
+    else if (getLoopingBars() > 0.0 && getPlayFromBar() == barNumber)
+        m_saveLoopStart = true;
+
+    jumpToBar(barNumber, bar);
+
+    // The score also needs to know the time and the key signature
+    CMidiEvent event;
+    event.metaEvent(0, MIDI_PB_timeSignature, bar.timeSigTop, bar.timeSigBottom);
+    m_scoreWin->midiEventInsert(event);
+    if (bar.hasKeySig)
+    {
+        event.metaEvent(0, MIDI_PB_keySignature, bar.keySig, bar.majorKey);
+        m_scoreWin->midiEventInsert(event);
+    }
+
+    // The next event and chord are timed from the start of the bar
+    m_firstEventDelta = bar.eventTick - bar.tick;
+    m_readTick = bar.tick;
+    m_chordTick = m_nextChordTick = bar.tick;
+    m_nextChord = 0;
+    m_chordList = 0; // find the first chord in the bar again
+}
+
+// Called once the events at the start of the loop have been queued, before any have been played
+void CSong::saveLoopStart()
+{
+    m_loopStartBar = getPlayFromBar();
+    m_loopStartEventIndex = m_midiFile->getEventIndex();
+    m_loopStartFindChord = m_findChord;
+    m_loopStartReachedEof = m_reachedMidiEof;
+    m_loopStartNextChord = m_nextChord;
+    m_loopStartChordTick = m_chordTick;
+    m_loopStartReadTick = m_readTick;
+    this->CConductor::saveLoopStart();
+    m_scoreWin->saveLoopStart();
+    m_haveLoopStart = true;
+}
+
+// Goes straight back to the start of the loop, returns false if it has to be found again
+bool CSong::restoreLoopStart()
+{
+    barIndexEntry_t bar;
+    int barNumber = static_cast<int>(m_loopStartBar);
+
+    if (m_haveLoopStart == false || m_loopStartBar != getPlayFromBar() || getLoopingBars() <= 0.0)
+        return false;
+    if (getBarIndex()->findBar(barNumber, &bar) == false || m_midiFile->seekToEvent(m_loopStartEventIndex) == false)
+        return false;
+
+    this->CConductor::restoreLoopStart(barNumber, bar);
+    m_scoreWin->restoreLoopStart();
+    m_findChord = m_loopStartFindChord;
+    m_reachedMidiEof = m_loopStartReachedEof;
+    m_nextChord = m_loopStartNextChord;
+    m_chordTick = m_loopStartChordTick;
+    m_nextChordTick = m_chordTick + 1;
+    m_readTick = m_loopStartReadTick;
+    m_firstEventDelta = -1;
+    m_atSongStart = false;
+    forceScoreRedraw();
+    return true;
+}
+
+eventBits_t CSong::task(qint64 nSecTicks)
 {
-    realTimeEngine(ticks);
+    if (m_atSongStart && playingMusic())
+    {
+        if (seekingBarNumber())
+            jumpToStartBar();
+        m_atSongStart = false;
+    }
+
+    realTimeEngine(nSecTicks);
 
+    // Start the loop again straight away rather than waiting for the next screen update
+    if ((m_realTimeEventBits & EVENT_BITS_UptoBarReached) != 0 && restoreLoopStart())
+        m_realTimeEventBits &= ~EVENT_BITS_UptoBarReached;
+
+    CChordList* chordList = getChordList();
 
     while (true)
     {
@@ -183,11 +354,19 @@ eventBits_t CSong::task(int ticks)
 
             // Read the next events
             CMidiEvent event = m_midiFile->readMidiEvent();
+            if (m_firstEventDelta >= 0)
+            {
+                event.setDeltaTime(m_firstEventDelta);
+                m_firstEventDelta = -1;
+            }
+            m_readTick += event.deltaTime();
 
             //ppLogTrace("Song event delta %d type 0x%x chan %d Note %d", event.deltaTime(), event.type(), event.channel(), event.note());
 
             // Find the next chord
-            if (m_findChord.findChord(event, getActiveChannel(), PB_PART_both) == true)
+            if (chordList != 0)
+                insertChords(chordList, m_midiFile->getEventIndex());
+            else if (m_findChord.findChord(event, getActiveChannel(), PB_PART_both) == true)
                 chordEventInsert( m_findChord.getChord() ); // give the Conductor the chord event
 
             // send the events to the other end
@@ -216,11 +395,34 @@ eventBits_t CSong::task(int ticks)
     }
 
 exitTask:
+    if (m_saveLoopStart)
+    {
+        m_saveLoopStart = false;
+        saveLoopStart();
+    }
     eventBits_t eventBits = m_realTimeEventBits;
     m_realTimeEventBits = 0;
     return eventBits;
 }
 
+eventBits_t CSong::runVirtualTime(qint64 stepNanos, qint64 durationNanos)
+{
+    CMidiDeviceVirtual* device = getVirtualDevice();
+    eventBits_t eventBits = 0;
+
+    if (device == 0 || stepNanos <= 0)
+        return 0;
+    for (qint64 elapsed = 0; elapsed < durationNanos; elapsed += stepNanos)
+    {
+        device->setTimeNanos(device->getTimeNanos() + stepNanos);
+        eventBits |= task(stepNanos);
+        // Not the event bit, as loading the song also sets that
+        if (!playingMusic())
+            break;
+    }
+    return eventBits;
+}
+
 static const struct pcNote_s
 {
     int key;
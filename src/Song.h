@@ -31,21 +31,27 @@
 
 #include <QString>
 
-#include "Notation.h"
 #include "Conductor.h"
-#include "TrackList.h"
+#include "TrackAnalysis.h"
 
 #define PC_KEY_LOWEST_NOTE    58
 #define PC_KEY_HIGHEST_NOTE    75
 
-class CSong : public CConductor
+class CSong : public CConductor, public CMidiEventAnalyser
 {
 public:
     CSong()
     {
         CStavePos::setKeySignature( NOT_USED, 0 );
         m_midiFile = new CMidiFile;
-        m_trackList = new CTrackList;
+        m_trackAnalysis = &m_defaultTrackAnalysis;
+        m_midiFile->setAnalyser(this);
+        m_saveLoopStart = false;
+        m_haveLoopStart = false;
+        m_loopStartBar = 0.0;
+        m_loopStartEventIndex = 0;
+        m_loopStartReachedEof = false;
+        m_chordList = 0;
 
         reset();
     }
@@ -53,19 +59,32 @@ public:
     ~CSong()
     {
         delete m_midiFile;
-        delete m_trackList;
     }
 
     void reset()
     {
         m_reachedMidiEof = false;
+        m_atSongStart = true;
+        m_firstEventDelta = -1;
+        m_nextChord = 0;
+        m_chordTick = 0;
+        m_nextChordTick = 0;
+        m_readTick = 0;
         m_findChord.reset();
     }
 
-    void init2(CScore * scoreWin, CSettings* settings);
-    eventBits_t task(int ticks);
+    void init2(CScoreObserver * scoreWin, CSettingsObserver* settings);
+    // Where the converted songs are kept, the cache is not used until this is set
+    void setSongCacheDir(const QString& dir) {m_midiFile->setCacheDir(dir);}
+    // Called every few msec with the time since the last call, in nanoseconds
+    eventBits_t task(qint64 nSecTicks);
+    // Runs task() from the clock of the virtual device (see setVirtualDevice()) as fast as it can,
+    // in steps of stepNanos, for up to durationNanos or until the song stops
+    eventBits_t runVirtualTime(qint64 stepNanos, qint64 durationNanos);
     bool pcKeyPress(int key, bool down);
+    // Check getMidiError() afterwards to see if the song could be read
     void loadSong(const QString &filename);
+    midiErrors_t getMidiError() {return m_midiFile->getMidiError();}
     void regenerateChordQueue();
 
     void rewind();
@@ -83,21 +102,56 @@ public:
 
     void setActiveChannel(int part);
     void setPlayMode(playMode_t mode);
-    CTrackList* getTrackList() {return m_trackList;}
+    // The track list of the GUI collects the channels of the song in place of the default one
+    void setTrackAnalysis(CTrackAnalysis* trackAnalysis)
+    {
+        m_trackAnalysis = (trackAnalysis != 0) ? trackAnalysis : &m_defaultTrackAnalysis;
+    }
+    CTrackAnalysis* getTrackAnalysis() {return m_trackAnalysis;}
     void refreshScroll();
 
 
     QString getSongTitle() {return m_songTitle;}
+    // The lyrics and markers, the ticks are midi ticks from the start of the song
+    CSongText* getSongText() {return m_midiFile->getSongText();}
 
 private:
-    void midiFileInfo();
+    void clearSongInfo();
+    void examineMidiEvent(CMidiEvent event);
+    void jumpToStartBar();
+    void saveLoopStart();
+    bool restoreLoopStart();
+    void buildChordLists();
+    CChordList* getChordList();
+    void insertChords(CChordList* chordList, size_t eventCount);
 
 
     CMidiFile * m_midiFile;
     CFindChord m_findChord;
     bool m_reachedMidiEof;
+    bool m_atSongStart;     // Nothing has been played since the song was rewound
+    int m_firstEventDelta;  // Replaces the delta time of the next event read, -1 if not used
+    bool m_saveLoopStart;   // Save the state at the end of this task, as playing is at the start of the loop
+    bool m_haveLoopStart;
+    double m_loopStartBar;
+    size_t m_loopStartEventIndex;
+    CFindChord m_loopStartFindChord;
+    bool m_loopStartReachedEof;
+    size_t m_loopStartNextChord;
+    int m_loopStartChordTick;
+    int m_loopStartReadTick;
+
+    // The chord lists are not used when the song is streamed
+    CChordList m_chordLists[MAX_MIDI_CHANNELS]; // One for each channel, the notes are split at middle C
+    CChordList m_pianoPartChordList; // The two channels used by the left and right hands
+    CChordList* m_chordList;    // The list for the active channel, 0 if none
+    size_t m_nextChord;     // The next chord in the list to give to the conductor
+    int m_chordTick;        // The tick of the last chord given to the conductor
+    int m_nextChordTick;    // Where to carry on from if a different list is used
+    int m_readTick;         // The tick of the last song event that was read
     CChord m_fakeChord;  // the chord played with the tab key
-    CTrackList* m_trackList;
+    CTrackAnalysis* m_trackAnalysis;
+    CTrackAnalysis m_defaultTrackAnalysis;
     QString m_songTitle;
 };
 
@@ -0,0 +1,222 @@
+/*********************************************************************************/
+/*!
+@file           SongCache.cpp
+
+@brief          Keeps the decoded and merged midi events of each song in a binary cache file.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include <string.h>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QCryptographicHash>
+#include <QThreadPool>
+#include <QRunnable>
+
+#include "SongCache.h"
+
+// The cache file is this header followed by the events, the song text entries, the song text,
+// the song title and then the midi file path
+typedef struct
+{
+    char magic[8];
+    quint32 version;
+    quint32 eventSize;      // sizeof(CMidiEvent) when the cache was written
+    qint64 midiFileSize;
+    qint64 midiFileTime;    // The modification time of the midi file in msec since the epoch
+    qint32 ppqn;
+    qint32 keySig;          // NO_KEY_SIGNATURE if the song has none
+    qint32 majorKey;
+    quint32 eventCount;
+    quint32 textEntryCount;
+    quint32 textLength;
+    quint32 titleLength;    // utf8 bytes
+    quint32 pathLength;     // utf8 bytes
+} songCacheHeader_t;
+
+static const char s_cacheMagic[8] = "PBCACHE";
+
+// Writes a cache file that has already been put together in memory
+class CSaveSongCacheTask : public QRunnable
+{
+public:
+    CSaveSongCacheTask(const QString& fileName, const QByteArray& data) : m_fileName(fileName), m_data(data) {}
+
+    void run()
+    {
+        QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+        // QSaveFile writes to a temporary file first so a reader never sees half a cache
+        QSaveFile file(m_fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(m_data) != m_data.size() || !file.commit())
+            ppLogWarn("Cannot write the song cache %s", qPrintable(m_fileName));
+    }
+
+private:
+    QString m_fileName;
+    QByteArray m_data;
+};
+
+
+QString CSongCache::cacheFileName(const QString& midiFileName)
+{
+    QByteArray path = QFileInfo(midiFileName).absoluteFilePath().toUtf8();
+    QString hash = QCryptographicHash::hash(path, QCryptographicHash::Md5).toHex();
+    return m_cacheDir + "/" + hash + ".pbcache";
+}
+
+void CSongCache::unload()
+{
+    if (m_mappedData != 0)
+        m_cacheFile.unmap(m_mappedData);
+    if (m_cacheFile.isOpen())
+        m_cacheFile.close();
+    m_mappedData = 0;
+    m_events = 0;
+    m_eventCount = 0;
+    m_ppqn = 0;
+    m_songTitle.clear();
+    m_keySig = NO_KEY_SIGNATURE;
+    m_majorKey = 0;
+    m_textEntries = 0;
+    m_textEntryCount = 0;
+    m_textData = 0;
+    m_textLength = 0;
+}
+
+bool CSongCache::load(const QString& midiFileName)
+{
+    unload();
+
+    if (!enabled())
+        return false;
+
+    QFileInfo midiInfo(midiFileName);
+    if (!midiInfo.exists())
+        return false;
+
+    m_cacheFile.setFileName(cacheFileName(midiFileName));
+    if (!m_cacheFile.open(QIODevice::ReadOnly))
+        return false;
+
+    qint64 cacheSize = m_cacheFile.size();
+    if (cacheSize < static_cast<qint64>(sizeof(songCacheHeader_t)))
+    {
+        unload();
+        return false;
+    }
+
+    m_mappedData = m_cacheFile.map(0, cacheSize);
+    if (m_mappedData == 0)
+    {
+        unload();
+        return false;
+    }
+
+    const songCacheHeader_t* header = reinterpret_cast<const songCacheHeader_t*>(m_mappedData);
+    qint64 expectedSize = sizeof(songCacheHeader_t) + static_cast<qint64>(header->eventCount) * sizeof(CMidiEvent) +
+                          static_cast<qint64>(header->textEntryCount) * sizeof(songTextEntry_t) +
+                          header->textLength + header->titleLength + header->pathLength;
+
+    if (memcmp(header->magic, s_cacheMagic, sizeof(s_cacheMagic)) != 0 ||
+        header->version != SONG_CACHE_VERSION ||
+        header->eventSize != sizeof(CMidiEvent) ||
+        header->eventCount == 0 ||
+        expectedSize != cacheSize ||
+        header->midiFileSize != midiInfo.size() ||
+        header->midiFileTime != midiInfo.lastModified().toMSecsSinceEpoch())
+    {
+        unload();
+        return false;
+    }
+
+    const uchar* songText = m_mappedData + sizeof(songCacheHeader_t) + header->eventCount * sizeof(CMidiEvent);
+    const char* textData = reinterpret_cast<const char*>(songText + header->textEntryCount * sizeof(songTextEntry_t));
+    const char* text = textData + header->textLength;
+    QString title = QString::fromUtf8(text, header->titleLength);
+    QString path = QString::fromUtf8(text + header->titleLength, header->pathLength);
+
+    // Two paths with the same hash
+    if (path != midiInfo.absoluteFilePath())
+    {
+        unload();
+        return false;
+    }
+
+    m_events = reinterpret_cast<const CMidiEvent*>(m_mappedData + sizeof(songCacheHeader_t));
+    m_eventCount = header->eventCount;
+    m_ppqn = header->ppqn;
+    m_songTitle = title;
+    m_keySig = header->keySig;
+    m_majorKey = header->majorKey;
+    m_textEntries = reinterpret_cast<const songTextEntry_t*>(songText);
+    m_textEntryCount = header->textEntryCount;
+    m_textData = textData;
+    m_textLength = header->textLength;
+    ppLogInfo("Using the song cache for %s", qPrintable(midiFileName));
+    return true;
+}
+
+void CSongCache::saveInBackground(const QString& midiFileName, const vector<CMidiEvent>& events, int ppqn, const QString& title,
+                                  int keySig, int majorKey, const CSongText& songText)
+{
+    if (!enabled() || events.size() == 0)
+        return;
+
+    QFileInfo midiInfo(midiFileName);
+    QByteArray titleBytes = title.toUtf8();
+    QByteArray pathBytes = midiInfo.absoluteFilePath().toUtf8();
+
+    songCacheHeader_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, s_cacheMagic, sizeof(s_cacheMagic));
+    header.version = SONG_CACHE_VERSION;
+    header.eventSize = sizeof(CMidiEvent);
+    header.midiFileSize = midiInfo.size();
+    header.midiFileTime = midiInfo.lastModified().toMSecsSinceEpoch();
+    header.ppqn = ppqn;
+    header.keySig = keySig;
+    header.majorKey = majorKey;
+    header.eventCount = static_cast<quint32>(events.size());
+    header.textEntryCount = static_cast<quint32>(songText.getEntries().size());
+    header.textLength = static_cast<quint32>(songText.getTextData().size());
+    header.titleLength = titleBytes.size();
+    header.pathLength = pathBytes.size();
+
+    // Only the copy is done here, the disk write is left to the thread pool
+    QByteArray data;
+    data.reserve(sizeof(header) + events.size() * sizeof(CMidiEvent) + header.textEntryCount * sizeof(songTextEntry_t) +
+                 header.textLength + titleBytes.size() + pathBytes.size());
+    data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    data.append(reinterpret_cast<const char*>(&events[0]), events.size() * sizeof(CMidiEvent));
+    if (header.textEntryCount > 0)
+        data.append(reinterpret_cast<const char*>(&songText.getEntries()[0]), header.textEntryCount * sizeof(songTextEntry_t));
+    if (header.textLength > 0)
+        data.append(&songText.getTextData()[0], header.textLength);
+    data.append(titleBytes);
+    data.append(pathBytes);
+
+    QThreadPool::globalInstance()->start(new CSaveSongCacheTask(cacheFileName(midiFileName), data));
+}
@@ -0,0 +1,110 @@
+/*********************************************************************************/
+/*!
+@file           SongCache.h
+
+@brief          Keeps the decoded and merged midi events of each song in a binary cache file.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __SONG_CACHE_H__
+#define __SONG_CACHE_H__
+
+#include <QString>
+#include <QFile>
+#include <vector>
+#include "MidiEvent.h"
+#include "SongText.h"
+
+using namespace std;
+
+// Change this whenever the layout of the cache file or of CMidiEvent changes, or the events are decoded differently
+#define SONG_CACHE_VERSION  4
+
+/*!
+ * @brief   A ".pbcache" file holding the merged song events.
+ *
+ * The cache is keyed on the midi file path, size and modification time.
+ * A valid cache is memory mapped so the song can be played without decoding the midi file.
+ */
+class CSongCache
+{
+public:
+    CSongCache()
+    {
+        m_mappedData = 0;
+        m_events = 0;
+        m_eventCount = 0;
+        m_ppqn = 0;
+        m_keySig = NO_KEY_SIGNATURE;
+        m_majorKey = 0;
+        m_textEntries = 0;
+        m_textEntryCount = 0;
+        m_textData = 0;
+        m_textLength = 0;
+    }
+
+    ~CSongCache() { unload(); }
+
+    // The cache is disabled until a directory is set
+    void setCacheDir(const QString& dir) { m_cacheDir = dir; }
+    bool enabled() { return !m_cacheDir.isEmpty(); }
+
+    // Map the cache for this midi file, returns false if there is no valid cache
+    bool load(const QString& midiFileName);
+    void unload();
+
+    // Write the cache file using the Qt thread pool so the caller does not wait for the disk
+    void saveInBackground(const QString& midiFileName, const vector<CMidiEvent>& events, int ppqn, const QString& title,
+                          int keySig, int majorKey, const CSongText& songText);
+
+    const CMidiEvent* getEvents() { return m_events; }
+    size_t getEventCount() { return m_eventCount; }
+    int getPulsesPerQuarterNote() { return m_ppqn; }
+    QString getSongTitle() { return m_songTitle; }
+    int getKeySignature() { return m_keySig; }
+    int getMajorKey() { return m_majorKey; }
+    // The indexed song text
+    const songTextEntry_t* getTextEntries() { return m_textEntries; }
+    size_t getTextEntryCount() { return m_textEntryCount; }
+    const char* getTextData() { return m_textData; }
+    size_t getTextLength() { return m_textLength; }
+
+private:
+    QString cacheFileName(const QString& midiFileName);
+
+    QString m_cacheDir;
+    QFile m_cacheFile;
+    uchar* m_mappedData;
+    const CMidiEvent* m_events;   // Points into the mapped cache file
+    size_t m_eventCount;
+    int m_ppqn;
+    QString m_songTitle;
+    int m_keySig;
+    int m_majorKey;
+    const songTextEntry_t* m_textEntries;   // Points into the mapped cache file
+    size_t m_textEntryCount;
+    const char* m_textData;
+    size_t m_textLength;
+};
+
+#endif // __SONG_CACHE_H__
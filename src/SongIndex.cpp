@@ -0,0 +1,534 @@
+/*********************************************************************************/
+/*!
+@file           SongIndex.cpp
+
+@brief          Keeps an index of the songs in the music books, built by a background thread.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QMutexLocker>
+
+#include "SongIndex.h"
+#include "MidiFile.h"
+
+static const char s_indexMagic[] = "PBINDEX";
+
+typedef struct
+{
+    int tick;
+    int tempo;      // usec per quarter note
+} tempoChange_t;
+
+static bool tempoChangeLess(const tempoChange_t& a, const tempoChange_t& b)
+{
+    return a.tick < b.tick;
+}
+
+static QDataStream& operator<<(QDataStream& out, const songInfo_t& info)
+{
+    out << info.fileName << info.fileSize << info.fileTime << info.title;
+    out << static_cast<qint32>(info.trackCount) << static_cast<qint32>(info.channelCount);
+    out << static_cast<qint32>(info.noteCount) << info.duration;
+    out << static_cast<qint32>(info.minTempo) << static_cast<qint32>(info.maxTempo);
+    out << static_cast<qint32>(info.timeSigTop) << static_cast<qint32>(info.timeSigBottom);
+    out << static_cast<qint32>(info.keySig);
+    return out;
+}
+
+static QDataStream& operator>>(QDataStream& in, songInfo_t& info)
+{
+    qint32 value[8];
+    in >> info.fileName >> info.fileSize >> info.fileTime >> info.title;
+    in >> value[0] >> value[1] >> value[2] >> info.duration;
+    for (int i = 3; i < 8; i++)
+        in >> value[i];
+    info.trackCount = value[0];
+    info.channelCount = value[1];
+    info.noteCount = value[2];
+    info.minTempo = value[3];
+    info.maxTempo = value[4];
+    info.timeSigTop = value[5];
+    info.timeSigBottom = value[6];
+    info.keySig = value[7];
+    return in;
+}
+
+CSongIndex::CSongIndex()
+{
+    m_indexing = false;
+    m_stop.storeRelease(0);
+}
+
+CSongIndex::~CSongIndex()
+{
+    m_stop.storeRelease(1);
+    wait();
+}
+
+bool CSongIndex::isSongFile(const QString& name)
+{
+    return name.endsWith(".mid", Qt::CaseInsensitive) ||
+           name.endsWith(".midi", Qt::CaseInsensitive) ||
+           name.endsWith(".kar", Qt::CaseInsensitive);
+}
+
+// A book or a song in the music zip file has the time of the zip file
+bool CSongIndex::pathTime(const QString& path, qint64* size, qint64* time)
+{
+    QString zipFileName;
+    QFileInfo fileInfo(CMusicArchive::splitPath(path, &zipFileName, 0) ? zipFileName : path);
+    if (!fileInfo.exists())
+        return false;
+    *size = fileInfo.size();
+    *time = fileInfo.lastModified().toMSecsSinceEpoch();
+    return true;
+}
+
+void CSongIndex::setIndexFile(const QString& fileName)
+{
+    m_indexFileName = fileName;
+    load();
+}
+
+void CSongIndex::startIndexing(const QString& bookPath)
+{
+    QMutexLocker locker(&m_mutex);
+    m_nextBookPath = bookPath;
+    if (m_indexing)
+        return;
+    m_indexing = true;
+    locker.unlock();
+
+    // The thread may still be finishing off the last time it was started
+    wait();
+    start(QThread::LowestPriority);
+}
+
+void CSongIndex::run()
+{
+    while (true)
+    {
+        QString bookPath;
+        {
+            // Stop indexing in the same lock as the check, otherwise startIndexing() could
+            // set a new book path just after the check and then find the thread still running
+            QMutexLocker locker(&m_mutex);
+            if (m_nextBookPath.isEmpty() || m_stop.loadAcquire())
+            {
+                m_indexing = false;
+                break;
+            }
+            bookPath = m_nextBookPath;
+            m_nextBookPath.clear();
+        }
+        indexBooks(bookPath);
+    }
+}
+
+bool CSongIndex::getBookList(const QString& bookPath, QStringList* bookNames)
+{
+    qint64 size;
+    qint64 time;
+    if (!pathTime(bookPath, &size, &time))
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    QMap<QString, bookPathIndex_t>::const_iterator it = m_bookPaths.constFind(bookPath);
+    if (it == m_bookPaths.constEnd() || it.value().pathTime != time)
+        return false;
+    *bookNames = it.value().bookNames;
+    return true;
+}
+
+bool CSongIndex::getSongList(const QString& bookDir, QStringList* songNames)
+{
+    qint64 size;
+    qint64 time;
+    if (!pathTime(bookDir, &size, &time))
+        return false;
+
+    QMutexLocker locker(&m_mutex);
+    QMap<QString, bookIndex_t>::const_iterator it = m_books.constFind(bookDir);
+    if (it == m_books.constEnd() || it.value().bookTime != time)
+        return false;
+    songNames->clear();
+    for (int i = 0; i < it.value().songs.size(); i++)
+        songNames->append(it.value().songs.at(i).fileName);
+    return true;
+}
+
+bool CSongIndex::getSongInfo(const QString& bookDir, const QString& songName, songInfo_t* info)
+{
+    QMutexLocker locker(&m_mutex);
+    QMap<QString, bookIndex_t>::const_iterator it = m_books.constFind(bookDir);
+    if (it == m_books.constEnd())
+        return false;
+    QHash<QString, int>::const_iterator song = it.value().songLookup.constFind(songName);
+    if (song == it.value().songLookup.constEnd())
+        return false;
+    *info = it.value().songs.at(song.value());
+    return true;
+}
+
+void CSongIndex::lookupSongs(bookIndex_t* book)
+{
+    book->songLookup.clear();
+    for (int i = 0; i < book->songs.size(); i++)
+        book->songLookup.insert(book->songs.at(i).fileName, i);
+}
+
+void CSongIndex::indexBooks(const QString& bookPath)
+{
+    QStringList bookNames;
+    QString zipFileName;
+
+    if (CMusicArchive::splitPath(bookPath, &zipFileName, 0))
+    {
+        if (!m_musicArchive.contains(bookPath))
+            m_musicArchive.open(zipFileName);
+        bookNames = m_musicArchive.entryList(bookPath, true);
+    }
+    else
+    {
+        QDir dirBooks(bookPath);
+        dirBooks.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+        bookNames = dirBooks.entryList();
+    }
+
+    bool changed = false;
+    qint64 size;
+    bookPathIndex_t bookPathIndex;
+    bookPathIndex.bookNames = bookNames;
+    if (pathTime(bookPath, &size, &bookPathIndex.pathTime))
+    {
+        QMutexLocker locker(&m_mutex);
+        QMap<QString, bookPathIndex_t>::const_iterator it = m_bookPaths.constFind(bookPath);
+        if (it == m_bookPaths.constEnd() || it.value().pathTime != bookPathIndex.pathTime ||
+            it.value().bookNames != bookNames)
+        {
+            m_bookPaths.insert(bookPath, bookPathIndex);
+            changed = true;
+        }
+    }
+
+    for (int i = 0; i < bookNames.size() && !m_stop.loadAcquire(); i++)
+    {
+        QString bookDir = bookPath + bookNames.at(i);
+        bookIndex_t book;
+        book.bookTime = -1;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_books.contains(bookDir))
+                book = m_books.value(bookDir);
+        }
+        if (indexBook(bookDir, &book))
+        {
+            QMutexLocker locker(&m_mutex);
+            m_books.insert(bookDir, book);
+            changed = true;
+        }
+    }
+    if (changed && !m_stop.loadAcquire())
+        save();
+}
+
+// Update the index of one book, returns true if anything has changed
+bool CSongIndex::indexBook(const QString& bookDir, bookIndex_t* book)
+{
+    qint64 size;
+    qint64 time;
+    if (!pathTime(bookDir, &size, &time))
+        return false;
+
+    QStringList fileNames;
+    if (m_musicArchive.contains(bookDir))
+        fileNames = m_musicArchive.entryList(bookDir, false);
+    else
+    {
+        QDir dirSongs(bookDir);
+        dirSongs.setFilter(QDir::Files);
+        fileNames = dirSongs.entryList();
+    }
+
+    bool changed = (book->bookTime != time);
+    QList<songInfo_t> songs;
+    for (int i = 0; i < fileNames.size(); i++)
+    {
+        if (m_stop.loadAcquire())
+            return false;
+        if (!isSongFile(fileNames.at(i)))
+            continue;
+
+        QString fileName = bookDir + '/' + fileNames.at(i);
+        qint64 songSize = 0;
+        qint64 songTime = 0;
+        pathTime(fileName, &songSize, &songTime);
+
+        QHash<QString, int>::const_iterator old = book->songLookup.constFind(fileNames.at(i));
+        if (old != book->songLookup.constEnd() && book->songs.at(old.value()).fileSize == songSize &&
+            book->songs.at(old.value()).fileTime == songTime)
+        {
+            songs.append(book->songs.at(old.value()));
+            continue;
+        }
+
+        songInfo_t info;
+        info.fileName = fileNames.at(i);
+        info.fileSize = songSize;
+        info.fileTime = songTime;
+        vector<byte_t> data;
+        if (!readSong(fileName, data) || !scanSong(data, &info))
+            ppLogWarn("Cannot index %s", qPrintable(fileName));
+        songs.append(info);
+        changed = true;
+    }
+    if (songs.size() != book->songs.size())
+        changed = true;
+
+    book->bookTime = time;
+    book->songs = songs;
+    lookupSongs(book);
+    return changed;
+}
+
+bool CSongIndex::readSong(const QString& fileName, vector<byte_t>& data)
+{
+    if (m_musicArchive.contains(fileName))
+        return m_musicArchive.readFile(fileName, data);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    data.resize(static_cast<size_t>(file.size()));
+    if (data.size() == 0)
+        return false;
+    qint64 bytesRead = file.read(reinterpret_cast<char*>(&data[0]), file.size());
+    data.resize(static_cast<size_t>(qMax(bytesRead, static_cast<qint64>(0))));
+    return true;
+}
+
+// Decodes the tracks of the midi file, the tracks are not merged as only the totals are wanted
+bool CSongIndex::scanSong(const vector<byte_t>& data, songInfo_t* info)
+{
+    info->title.clear();
+    info->trackCount = 0;
+    info->channelCount = 0;
+    info->noteCount = 0;
+    info->duration = 0;
+    info->minTempo = 0;
+    info->maxTempo = 0;
+    info->timeSigTop = 0;
+    info->timeSigBottom = 0;
+    info->keySig = NO_KEY_SIGNATURE;
+
+    // "MThd", the header length, the format, the number of tracks and the ppqn
+    if (data.size() < MIDI_HEADER_LENGTH || memcmp(&data[0], "MThd", 4) != 0)
+        return false;
+    size_t trackCount = (data[10] << 8) | data[11];
+    int ppqn = (data[12] << 8) | data[13];
+    if (ppqn <= 0)
+        ppqn = DEFAULT_PPQN;
+
+    vector<tempoChange_t> tempoChanges;
+    int channels = 0;
+    int endTick = 0;
+    size_t filePos = MIDI_HEADER_LENGTH;
+    size_t trk;
+    for (trk = 0; trk < trackCount && filePos < data.size(); trk++)
+    {
+        CMidiTrack track(&data[0] + filePos, data.size() - filePos, static_cast<int>(trk));
+        if (track.failed())
+            break;
+        track.decodeTrack();
+        if (trk == 0)
+            info->title = track.getTrackName();
+        info->trackCount++;
+
+        int tick = 0;
+        while (track.length() > 0)
+        {
+            CMidiEvent event = track.pop();
+            tick += event.deltaTime();
+            switch (event.type())
+            {
+                case MIDI_NOTE_ON:
+                    info->noteCount++;
+                    channels |= 1 << event.channel();
+                    endTick = qMax(endTick, tick + static_cast<int>(event.getDuration()));
+                    break;
+
+                case MIDI_PB_tempo:
+                    if (event.tempo() > 0)
+                    {
+                        tempoChange_t change = {tick, event.tempo()};
+                        tempoChanges.push_back(change);
+                    }
+                    break;
+
+                case MIDI_PB_timeSignature:
+                    if (info->timeSigTop == 0)
+                    {
+                        info->timeSigTop = event.data1();
+                        info->timeSigBottom = event.data2();
+                    }
+                    break;
+
+                case MIDI_PB_keySignature:
+                    if (info->keySig == NO_KEY_SIGNATURE)
+                        info->keySig = event.data1();
+                    break;
+            }
+        }
+        endTick = qMax(endTick, tick);
+        if (track.failed())
+            break;
+        filePos += track.getTrackLength();
+    }
+
+    for (int chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        if (channels & (1 << chan))
+            info->channelCount++;
+    }
+
+    // Add up the time between each tempo change, the tempo is 120 beats per minute until it is set
+    stable_sort(tempoChanges.begin(), tempoChanges.end(), tempoChangeLess);
+    double usec = 0.0;
+    int lastTick = 0;
+    int tempo = 500000;
+    int minTempo = (tempoChanges.size() > 0) ? tempoChanges[0].tempo : tempo;
+    int maxTempo = minTempo;
+    for (size_t i = 0; i < tempoChanges.size(); i++)
+    {
+        minTempo = qMin(minTempo, tempoChanges[i].tempo);
+        maxTempo = qMax(maxTempo, tempoChanges[i].tempo);
+        if (tempoChanges[i].tick > endTick)
+            continue;
+        usec += static_cast<double>(tempoChanges[i].tick - lastTick) * tempo / ppqn;
+        lastTick = tempoChanges[i].tick;
+        tempo = tempoChanges[i].tempo;
+    }
+    usec += static_cast<double>(endTick - lastTick) * tempo / ppqn;
+    info->duration = static_cast<qint64>(usec / 1000.0);
+
+    // The fastest tempo has the fewest usec per beat
+    info->minTempo = 60000000 / maxTempo;
+    info->maxTempo = 60000000 / minTempo;
+    return (info->trackCount > 0);
+}
+
+bool CSongIndex::load()
+{
+    QFile file(m_indexFileName);
+    if (m_indexFileName.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+    QByteArray magic;
+    qint32 version;
+    qint32 bookCount;
+    in >> magic >> version >> bookCount;
+    if (in.status() != QDataStream::Ok || magic != s_indexMagic || version != SONG_INDEX_VERSION)
+        return false;
+
+    QMap<QString, bookIndex_t> books;
+    for (int i = 0; i < bookCount && in.status() == QDataStream::Ok; i++)
+    {
+        QString bookDir;
+        bookIndex_t book;
+        qint32 songCount;
+        in >> bookDir >> book.bookTime >> songCount;
+        for (int j = 0; j < songCount && in.status() == QDataStream::Ok; j++)
+        {
+            songInfo_t info;
+            in >> info;
+            book.songs.append(info);
+        }
+        lookupSongs(&book);
+        books.insert(bookDir, book);
+    }
+
+    QMap<QString, bookPathIndex_t> bookPaths;
+    qint32 bookPathCount = 0;
+    in >> bookPathCount;
+    for (int i = 0; i < bookPathCount && in.status() == QDataStream::Ok; i++)
+    {
+        QString bookPath;
+        bookPathIndex_t bookPathIndex;
+        in >> bookPath >> bookPathIndex.pathTime >> bookPathIndex.bookNames;
+        bookPaths.insert(bookPath, bookPathIndex);
+    }
+    if (in.status() != QDataStream::Ok)
+    {
+        ppLogWarn("The song index %s is corrupted", qPrintable(m_indexFileName));
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_books = books;
+    m_bookPaths = bookPaths;
+    return true;
+}
+
+bool CSongIndex::save()
+{
+    if (m_indexFileName.isEmpty())
+        return false;
+
+    QByteArray data;
+    {
+        QMutexLocker locker(&m_mutex);
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_0);
+        out << QByteArray(s_indexMagic) << static_cast<qint32>(SONG_INDEX_VERSION) << static_cast<qint32>(m_books.size());
+        QMap<QString, bookIndex_t>::const_iterator it;
+        for (it = m_books.constBegin(); it != m_books.constEnd(); ++it)
+        {
+            out << it.key() << it.value().bookTime << static_cast<qint32>(it.value().songs.size());
+            for (int i = 0; i < it.value().songs.size(); i++)
+                out << it.value().songs.at(i);
+        }
+        out << static_cast<qint32>(m_bookPaths.size());
+        QMap<QString, bookPathIndex_t>::const_iterator path;
+        for (path = m_bookPaths.constBegin(); path != m_bookPaths.constEnd(); ++path)
+            out << path.key() << path.value().pathTime << path.value().bookNames;
+    }
+
+    QDir().mkpath(QFileInfo(m_indexFileName).absolutePath());
+    QSaveFile file(m_indexFileName);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit())
+    {
+        ppLogWarn("Cannot write the song index %s", qPrintable(m_indexFileName));
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+/*********************************************************************************/
+/*!
+@file           SongIndex.h
+
+@brief          Keeps an index of the songs in the music books, built by a background thread.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __SONG_INDEX_H__
+#define __SONG_INDEX_H__
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+#include <QHash>
+#include <QMutex>
+#include <QThread>
+#include <QAtomicInt>
+#include <vector>
+#include "MidiTrack.h"
+#include "MusicArchive.h"
+
+using namespace std;
+
+// Change this whenever songInfo_t or the layout of the index file changes
+#define SONG_INDEX_VERSION  2
+
+// What is known about a song without loading it
+typedef struct
+{
+    QString fileName;       // The name of the song in its book
+    qint64 fileSize;
+    qint64 fileTime;        // The modification time in msec since the epoch
+    QString title;
+    int trackCount;
+    int channelCount;       // The number of channels that have notes
+    int noteCount;
+    qint64 duration;        // In msec
+    int minTempo;           // In beats per minute
+    int maxTempo;
+    int timeSigTop;         // 0 if the song has no time signature
+    int timeSigBottom;
+    int keySig;             // The number of sharps (or flats if negative), NO_KEY_SIGNATURE if there is none
+} songInfo_t;
+
+// The songs in one book folder
+typedef struct
+{
+    qint64 bookTime;        // The modification time of the book folder (or of the zip file)
+    QList<songInfo_t> songs;
+    QHash<QString, int> songLookup; // The position of each song in songs, this is not saved in the index file
+} bookIndex_t;
+
+// The book folders in a book path
+typedef struct
+{
+    qint64 pathTime;        // The modification time of the book path folder (or of the zip file)
+    QStringList bookNames;
+} bookPathIndex_t;
+
+/*!
+ * @brief   An index of every song in the music books, kept in a file so the books can be browsed straight away.
+ *
+ * The books are (re)indexed by a low priority thread. A song is only read again if its size or modification time
+ * has changed, and the songs in a book are only listed again when the book folder has changed.
+ */
+class CSongIndex : public QThread
+{
+public:
+    CSongIndex();
+    ~CSongIndex();
+
+    // Loads the index file, the index is saved there each time the books have been indexed
+    void setIndexFile(const QString& fileName);
+
+    // Index all the books in the book path in the background
+    void startIndexing(const QString& bookPath);
+
+    // The books in a book path, returns false if the path is not in the index or the folder has changed since
+    bool getBookList(const QString& bookPath, QStringList* bookNames);
+
+    // The songs in a book, returns false if the book is not in the index or the book folder has changed since
+    bool getSongList(const QString& bookDir, QStringList* songNames);
+    bool getSongInfo(const QString& bookDir, const QString& songName, songInfo_t* info);
+
+    // Reads the song info out of a midi file that is in memory
+    static bool scanSong(const vector<byte_t>& data, songInfo_t* info);
+
+protected:
+    void run();
+
+private:
+    bool load();
+    bool save();
+    void indexBooks(const QString& bookPath);
+    bool indexBook(const QString& bookDir, bookIndex_t* book);
+    bool readSong(const QString& fileName, vector<byte_t>& data);
+    static bool pathTime(const QString& path, qint64* size, qint64* time);
+    static bool isSongFile(const QString& name);
+    static void lookupSongs(bookIndex_t* book);
+
+    QMutex m_mutex;                     // Guards m_books, m_bookPaths and m_nextBookPath
+    QMap<QString, bookIndex_t> m_books; // Keyed on the book folder path
+    QMap<QString, bookPathIndex_t> m_bookPaths;
+    QString m_indexFileName;
+    QString m_nextBookPath;             // The book path waiting to be indexed
+    bool m_indexing;                    // The thread has been started and has not yet stopped indexing
+    QAtomicInt m_stop;                  // Set to stop the indexing thread
+    CMusicArchive m_musicArchive;       // Only used by the indexing thread
+};
+
+#endif // __SONG_INDEX_H__
@@ -0,0 +1,118 @@
+/*********************************************************************************/
+/*!
+@file           SongText.cpp
+
+@brief          The lyrics, markers and other text events of a song, indexed by their tick.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include <algorithm>
+#include "SongText.h"
+
+static bool entryBefore(const songTextEntry_t& a, const songTextEntry_t& b)
+{
+    return a.tick < b.tick;
+}
+
+void CSongText::clear()
+{
+    m_entries.clear();
+    m_text.clear();
+    for (int type = 0; type < SONG_TEXT_TYPES; type++)
+        m_typeIndex[type].clear();
+}
+
+void CSongText::add(int tick, songTextType_t type, const string& text)
+{
+    songTextEntry_t entry;
+    entry.tick = tick;
+    entry.type = type;
+    entry.offset = static_cast<quint32>(m_text.size());
+    entry.length = static_cast<quint32>(text.size());
+    m_text.insert(m_text.end(), text.begin(), text.end());
+    m_entries.push_back(entry);
+}
+
+void CSongText::append(const CSongText& other)
+{
+    quint32 textBase = static_cast<quint32>(m_text.size());
+    m_text.insert(m_text.end(), other.m_text.begin(), other.m_text.end());
+    for (size_t i = 0; i < other.m_entries.size(); i++)
+    {
+        songTextEntry_t entry = other.m_entries[i];
+        entry.offset += textBase;
+        m_entries.push_back(entry);
+    }
+}
+
+void CSongText::buildIndex()
+{
+    stable_sort(m_entries.begin(), m_entries.end(), entryBefore);
+    for (int type = 0; type < SONG_TEXT_TYPES; type++)
+        m_typeIndex[type].clear();
+    for (size_t i = 0; i < m_entries.size(); i++)
+    {
+        int type = m_entries[i].type;
+        if (type >= 0 && type < SONG_TEXT_TYPES)
+            m_typeIndex[type].push_back(static_cast<int>(i));
+    }
+}
+
+void CSongText::assign(const songTextEntry_t* entries, size_t entryCount, const char* text, size_t textLength)
+{
+    clear();
+    m_text.assign(text, text + textLength);
+    for (size_t i = 0; i < entryCount; i++)
+    {
+        // Don't trust an entry that points outside the text
+        if (entries[i].offset > textLength || entries[i].length > textLength - entries[i].offset)
+            continue;
+        m_entries.push_back(entries[i]);
+    }
+    buildIndex();
+}
+
+QString CSongText::getText(songTextType_t type, int index)
+{
+    const songTextEntry_t& entry = m_entries[m_typeIndex[type][index]];
+    if (entry.length == 0)
+        return QString();
+    return QString::fromUtf8(&m_text[entry.offset], entry.length);
+}
+
+int CSongText::findText(songTextType_t type, int tick)
+{
+    const vector<int>& index = m_typeIndex[type];
+    // The first entry after the tick, the one before it is the one wanted
+    int low = 0;
+    int high = static_cast<int>(index.size());
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (m_entries[index[mid]].tick <= tick)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low - 1;
+}
@@ -0,0 +1,93 @@
+/*********************************************************************************/
+/*!
+@file           SongText.h
+
+@brief          The lyrics, markers and other text events of a song, indexed by their tick.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __SONG_TEXT_H__
+#define __SONG_TEXT_H__
+
+#include <QString>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef enum
+{
+    SONG_TEXT_text,         // METATEXT, the .kar files keep their lyrics in these
+    SONG_TEXT_lyric,        // METALYRIC
+    SONG_TEXT_marker,       // METAMARKER
+    SONG_TEXT_cuePoint,     // METACUEPT
+    SONG_TEXT_TYPES
+} songTextType_t;
+
+typedef struct
+{
+    qint32 tick;            // The absolute time in midi ticks
+    qint32 type;            // songTextType_t
+    quint32 offset;         // Where the text starts in the text data
+    quint32 length;
+} songTextEntry_t;
+
+/*!
+ * @brief   The text events of a song.
+ *
+ * All the text is kept in one block, so the song only has one allocation for the text however
+ * many lyrics it has. Each type of text has its own list sorted by tick, so the text at a tick
+ * can be found with a binary search every frame.
+ */
+class CSongText
+{
+public:
+    CSongText() { clear(); }
+
+    void clear();
+    void add(int tick, songTextType_t type, const string& text);
+    // Add the text of another track, buildIndex() must be called once all the tracks are added
+    void append(const CSongText& other);
+    // Sort the text by tick, text at the same tick keeps the order it was added in
+    void buildIndex();
+    // Replace the text with a copy of text that has already been indexed (from the song cache)
+    void assign(const songTextEntry_t* entries, size_t entryCount, const char* text, size_t textLength);
+
+    int getCount(songTextType_t type) { return static_cast<int>(m_typeIndex[type].size()); }
+    int getTick(songTextType_t type, int index) { return m_entries[m_typeIndex[type][index]].tick; }
+    QString getText(songTextType_t type, int index);
+
+    // The last text of this type at or before the tick, -1 if there is none
+    int findText(songTextType_t type, int tick);
+
+    // All the entries sorted by tick, and the text that they point into
+    const vector<songTextEntry_t>& getEntries() const { return m_entries; }
+    const vector<char>& getTextData() const { return m_text; }
+
+private:
+    vector<songTextEntry_t> m_entries;
+    vector<char> m_text;
+    vector<int> m_typeIndex[SONG_TEXT_TYPES];   // The entries of each type, in tick order
+};
+
+#endif // __SONG_TEXT_H__
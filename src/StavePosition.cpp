@@ -28,13 +28,13 @@
 
 
 #include "StavePosition.h"
-#include "Draw.h"
 
 float CStavePos::m_staveCenterY;
 int CStavePos::m_KeySignature;
 int CStavePos::m_KeySignatureMajorMinor;
 const staveLookup_t*  CStavePos::m_staveLookUpTable;
 float CStavePos::m_staveCentralOffset = (staveHeight() * 3)/2;
+int CStavePos::m_staveRedraw = 1;
 
 ////////////////////////////////////////////////////////////////////////////////
 //! @brief Calculates the position of a note on the stave
@@ -92,7 +92,7 @@ void CStavePos::setKeySignature(int key, int majorMinor)
     if (key == NOT_USED)
         key = 0;
     m_staveLookUpTable = getstaveLookupTable(key);
-    CDraw::forceCompileRedraw();
+    forceStaveRedraw();
 }
 
 const staveLookup_t* CStavePos::getstaveLookupTable(int key)
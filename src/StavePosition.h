@@ -118,6 +118,9 @@ public:
     static void setKeySignature(int key, int majorMinor);
     static int getKeySignature() {return m_KeySignature;}
     static void setStaveCentralOffset(float gap) { m_staveCentralOffset = gap; }
+    // Set when the staves must be drawn again (e.g. the key signature has changed), the display clears it
+    static void forceStaveRedraw(int value = 1) { m_staveRedraw = value; }
+    static int getStaveRedraw() { return m_staveRedraw; }
     static float verticalNoteSpacing()      {return 7;}
     static float staveHeight()              {return verticalNoteSpacing() * 8;}
     static float staveCentralOffset()       {return m_staveCentralOffset;}
@@ -158,6 +161,7 @@ private:
     static const staveLookup_t*  m_staveLookUpTable;
     static float m_staveCentralOffset;
     static float m_staveCenterY;
+    static int m_staveRedraw;
 };
 
 #endif //__STAVE_POS_H__
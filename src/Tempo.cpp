@@ -27,6 +27,7 @@
 /*********************************************************************************/
 
 
+#include <algorithm>
 #include "Tempo.h"
 
 int CTempo::m_cfg_followTempoAmount = 0;
@@ -66,6 +67,45 @@ void CTempo::adjustTempo(int * ticks)
     }
 }
 
+void CTempoMap::addTempoChange(int tick, int tempo)
+{
+    tempoMapEntry_t& last = m_entries.back();
+    if (tempo <= 0)
+        return;
+    // A later tempo at the same tick replaces the earlier one
+    if (tick == last.tick)
+    {
+        last.tempo = tempo;
+        return;
+    }
+    tempoMapEntry_t entry;
+    entry.tick = tick;
+    entry.tempo = tempo;
+    entry.micros = last.micros + static_cast<qint64>(tempoTicksToMicros(tick - last.tick, last.tempo));
+    m_entries.push_back(entry);
+}
 
+qint64 CTempoMap::tickToMicros(int tick)
+{
+    // Find the last tempo change at or before the tick
+    vector<tempoMapEntry_t>::const_iterator it = upper_bound(m_entries.begin(), m_entries.end(), tick, tickBeforeEntry);
+    if (it != m_entries.begin())
+        --it;
+    return it->micros + static_cast<qint64>(tempoTicksToMicros(tick - it->tick, it->tempo));
+}
 
+int CTempoMap::getTempo(int tick)
+{
+    vector<tempoMapEntry_t>::const_iterator it = upper_bound(m_entries.begin(), m_entries.end(), tick, tickBeforeEntry);
+    if (it != m_entries.begin())
+        --it;
+    return it->tempo;
+}
 
+int CTempoMap::microsToTick(qint64 micros)
+{
+    vector<tempoMapEntry_t>::const_iterator it = upper_bound(m_entries.begin(), m_entries.end(), micros, microsBeforeEntry);
+    if (it != m_entries.begin())
+        --it;
+    return it->tick + static_cast<int>(tempoMicrosToTicks(static_cast<double>(micros - it->micros), it->tempo));
+}
@@ -29,11 +29,65 @@
 #ifndef __TEMPO_H__
 #define __TEMPO_H__
 
+#include <vector>
+#include <math.h>
 #include "MidiEvent.h"
 #include "MidiFile.h"
 #include "Chord.h"
 
 #define MICRO_SECOND 1000000.0
+#define DEFAULT_MIDI_TEMPO  500000  // 120 beats per minute in microseconds-per-MIDI-quarter-note
+
+// Every tempo change in the song so a song tick can be turned into a time (and back again)
+class CTempoMap
+{
+public:
+    CTempoMap() { clear(); }
+
+    void clear()
+    {
+        tempoMapEntry_t start = {0, DEFAULT_MIDI_TEMPO, 0};
+        m_entries.clear();
+        m_entries.push_back(start);
+        m_currentTick = 0;
+    }
+
+    // Called for every event of the (merged) song, in order, when the song is loaded
+    void examineMidiEvent(CMidiEvent event)
+    {
+        m_currentTick += event.deltaTime();
+        if (event.type() == MIDI_PB_tempo)
+            addTempoChange(m_currentTick, event.tempo());
+    }
+
+    // The times are from the start of the song at the tempo set in the midi file (not the user's speed)
+    qint64 tickToMicros(int tick);
+    int microsToTick(qint64 micros);
+    // The midi tempo at a tick
+    int getTempo(int tick);
+
+    // The one conversion between song ticks and microseconds at a midi tempo, the engine's clock uses it too
+    static double tempoTicksToMicros(double ticks, int tempo) { return ticks * tempo / CMidiFile::getPulsesPerQuarterNote(); }
+    static double tempoMicrosToTicks(double micros, int tempo) { return micros * CMidiFile::getPulsesPerQuarterNote() / tempo; }
+
+    // The length of the song in ticks
+    int getSongTicks() { return m_currentTick; }
+
+private:
+    typedef struct
+    {
+        int tick;
+        int tempo;      // microseconds-per-MIDI-quarter-note from this tick onwards
+        qint64 micros;  // The time of this tick
+    } tempoMapEntry_t;
+
+    void addTempoChange(int tick, int tempo);
+    static bool tickBeforeEntry(int tick, const tempoMapEntry_t& entry) { return tick < entry.tick; }
+    static bool microsBeforeEntry(qint64 micros, const tempoMapEntry_t& entry) { return micros < entry.micros; }
+
+    vector<tempoMapEntry_t> m_entries;  // Sorted by tick (and so also by time)
+    int m_currentTick;
+};
 
 // Define a chord
 class CTempo
@@ -52,14 +106,17 @@ public:
         // 120 beats per minute is the default
         setMidiTempo(static_cast<int>(( 60 * MICRO_SECOND ) / 120 ));
         m_jumpAheadDelta = 0;
+        m_tickFraction = 0.0;
+        m_tickPosition = 0;
     }
 
     // Tempo, microseconds-per-MIDI-quarter-note
     void setMidiTempo(int tempo)
     {
-        m_midiTempo = (static_cast<float>(tempo) * DEFAULT_PPQN) / CMidiFile::getPulsesPerQuarterNote();
-        ppLogWarn("Midi Tempo %f  ppqn %d %d", m_midiTempo, CMidiFile::getPulsesPerQuarterNote(), tempo);
+        m_midiTempo = tempo;
+        ppLogWarn("Midi Tempo %d  ppqn %d", m_midiTempo, CMidiFile::getPulsesPerQuarterNote());
     }
+    int getMidiTempo() { return m_midiTempo; }
 
     void setSpeed(float speed)
     {
@@ -72,9 +129,54 @@ public:
     }
     float getSpeed() {return m_userSpeed;}
 
+    // The engine's ticks are the song's ticks times SPEED_ADJUST_FACTOR, played at the user's speed
     int mSecToTicks(int mSec)
     {
-        return static_cast<int>(mSec * m_userSpeed * (100.0 * MICRO_SECOND) /m_midiTempo);
+        return uSecToTicks(static_cast<qint64>(mSec) * 1000);
+    }
+    int uSecToTicks(qint64 uSec)
+    {
+        return static_cast<int>(CTempoMap::tempoMicrosToTicks(static_cast<double>(uSec) * m_userSpeed, m_midiTempo) * SPEED_ADJUST_FACTOR);
+    }
+    qint64 ticksToUSec(int ticks)
+    {
+        return static_cast<qint64>(CTempoMap::tempoTicksToMicros(static_cast<double>(ticks) / SPEED_ADJUST_FACTOR, m_midiTempo) / m_userSpeed);
+    }
+
+    // Turns the time since the last call into ticks. The part of a tick that is left over is
+    // carried on to the next call, so the song doesn't slowly fall behind the clock.
+    int nSecToTicks(qint64 nSec)
+    {
+        double ticks = CTempoMap::tempoMicrosToTicks(static_cast<double>(nSec) * m_userSpeed / 1000.0, m_midiTempo) * SPEED_ADJUST_FACTOR +
+                       m_tickFraction;
+        int wholeTicks = static_cast<int>(floor(ticks));
+        m_tickFraction = ticks - wholeTicks;
+        m_tickPosition += wholeTicks;
+        return wholeTicks;
+    }
+    // All the ticks returned by nSecToTicks() since the last reset()
+    qint64 getTickPosition() { return m_tickPosition; }
+
+    // The ticks already played past a tempo change were found at the old tempo, this gives them at the
+    // new one. The part of a tick left over is carried like in nSecToTicks().
+    int retimeTicks(int ticks, int oldTempo)
+    {
+        double newTicks = static_cast<double>(ticks) * oldTempo / m_midiTempo + m_tickFraction;
+        int wholeTicks = static_cast<int>(floor(newTicks));
+        m_tickFraction = newTicks - wholeTicks;
+        m_tickPosition += wholeTicks - ticks;
+        return wholeTicks;
+    }
+
+    CTempoMap* getTempoMap() { return &m_tempoMap; }
+    // The time of a song tick when played at the user's speed
+    qint64 tickToMicros(int tick)
+    {
+        return static_cast<qint64>(m_tempoMap.tickToMicros(tick) / m_userSpeed);
+    }
+    int microsToTick(qint64 micros)
+    {
+        return m_tempoMap.microsToTick(static_cast<qint64>(micros * m_userSpeed));
     }
 
     void insertPlayingTicks(int ticks)
@@ -103,11 +205,14 @@ public:
 
 private:
     float m_userSpeed; // controls the speed of the piece playing
-    float m_midiTempo; // controls the speed of the piece playing
+    int m_midiTempo; // microseconds-per-MIDI-quarter-note, controls the speed of the piece playing
     int m_jumpAheadDelta;
+    double m_tickFraction;  // The part of a tick not yet returned by nSecToTicks()
+    qint64 m_tickPosition;
     static int m_cfg_maxJumpAhead;
     static int m_cfg_followTempoAmount;
     CChord *m_savedWantedChord; // A copy of the wanted chord complete with both left and right parts
+    CTempoMap m_tempoMap;
 
 
 };
@@ -0,0 +1,178 @@
+/*********************************************************************************/
+/*!
+@file           TrackAnalysis.cpp
+
+@brief          Finds the channels, the first patches and the notes used by a song.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#include "TrackAnalysis.h"
+#include "Cfg.h"
+
+void CTrackAnalysis::clear()
+{
+    int chan;
+
+    for (chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        m_midiActiveChannels[chan] = false;
+        m_midiFirstPatchChannels[chan] = -1;
+        for (int i = 0; i < MAX_MIDI_NOTES; i++)
+            m_noteFrequency[chan][i]=0;
+    }
+}
+
+void CTrackAnalysis::examineMidiEvent(CMidiEvent event)
+{
+    int chan;
+    chan = event.channel();
+    assert (chan < MAX_MIDI_CHANNELS && chan >= 0);
+    if (chan < MAX_MIDI_CHANNELS && chan >= 0)
+    {
+        if (event.type() == MIDI_NOTE_ON)
+        {
+            m_midiActiveChannels[chan] = true;
+            // count each note so we can guess the key signature
+            if (event.note() >= 0 && event.note() < MAX_MIDI_NOTES)
+                m_noteFrequency[chan][event.note()]++;
+
+            // If we have a note and no patch then default to grand piano patch
+            if (m_midiFirstPatchChannels[chan] == -1)
+                m_midiFirstPatchChannels[chan] = GM_PIANO_PATCH;
+
+        }
+
+        if (event.type() == MIDI_PROGRAM_CHANGE && m_midiActiveChannels[chan] == false)
+            m_midiFirstPatchChannels[chan] = event.programme();
+    }
+}
+
+// Returns true if there is a piano part on channels 3 & 4
+bool CTrackAnalysis::pianoPartConvetionTest()
+{
+    if ((m_midiFirstPatchChannels[CONVENTION_LEFT_HAND_CHANNEL] == GM_PIANO_PATCH &&
+         m_midiActiveChannels[CONVENTION_LEFT_HAND_CHANNEL] == true &&
+         m_midiFirstPatchChannels[CONVENTION_RIGHT_HAND_CHANNEL]  <= GM_PIANO_PATCH))
+            return true;
+
+    if (m_midiFirstPatchChannels[CONVENTION_RIGHT_HAND_CHANNEL] == GM_PIANO_PATCH &&
+         m_midiActiveChannels[CONVENTION_RIGHT_HAND_CHANNEL] == true &&
+         m_midiFirstPatchChannels[CONVENTION_LEFT_HAND_CHANNEL]  <= GM_PIANO_PATCH)
+            return true;
+
+    if (m_midiFirstPatchChannels[CONVENTION_LEFT_HAND_CHANNEL] == GM_PIANO_PATCH &&
+        m_midiActiveChannels[CONVENTION_LEFT_HAND_CHANNEL] == true &&
+        m_midiFirstPatchChannels[CONVENTION_RIGHT_HAND_CHANNEL] <= GM_PIANO_PATCH)
+            return true;
+    return false;
+}
+
+int CTrackAnalysis::guessKeySignature(int chanA, int chanB)
+{
+    int chan;
+    int i;
+    int keySignature = 0;
+    int highScore = 0;
+    int scale[MIDI_OCTAVE];
+    for (i=0; i < MIDI_OCTAVE; i++)
+        scale[i] = 0;
+    for (chan = 0 ; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        if (chanA == -1 || chan == chanA || chan == chanB)
+        {
+            for (int note = 0; note < MAX_MIDI_NOTES; note++)
+                scale[note % MIDI_OCTAVE] += m_noteFrequency[chan][note];
+        }
+    }
+
+    for (i = 0; i < MIDI_OCTAVE; i++)
+    {
+        int score = 0;
+        struct {
+            int offset;
+            int key;
+        } keyLookUp[MIDI_OCTAVE] =
+            {
+                {0,  0}, // 0  C
+                {7,  1}, // 1  G  1#
+                {5, -1}, // 2  F  1b
+                {2,  2}, // 3  D  2#
+                {10,-2}, // 4  Bb 2b
+                {9,  3}, // 5  A  3#
+                {3, -3}, // 6  Eb 3b
+                {4,  4}, // 7  E  4#
+                {8, -4}, // 8  Ab 4b
+                {11, 5}, // 9  B  5#
+                {1, -5}, // 10 Db 5b
+                {6,  6}, // 11 F# 6#
+            };
+
+        int idx = keyLookUp[i].offset;
+        score += scale[(idx + 0 )%MIDI_OCTAVE]; // First note in the scale
+        score += scale[(idx + 2 )%MIDI_OCTAVE]; // Tone
+        score += scale[(idx + 4 )%MIDI_OCTAVE]; // Tone
+        score += scale[(idx + 5 )%MIDI_OCTAVE]; // Semi tone
+        score += scale[(idx + 7 )%MIDI_OCTAVE]; // Tone
+        score += scale[(idx + 9 )%MIDI_OCTAVE]; // Tone
+        score += scale[(idx + 11)%MIDI_OCTAVE]; // Tone
+                                                // the Last note don't count it
+
+        if (score > highScore)
+        {
+            highScore = score;
+            keySignature = keyLookUp[i].key;
+        }
+        /*
+        printf("key %2d score %3d :: ", keyLookUp[i].key, score);
+        for (int j=0; j < MIDI_OCTAVE; j++)
+            printf(" %d", scale[(keyLookUp[i].offset + j)%MIDI_OCTAVE]);
+        printf("\n");
+        */
+    }
+    return keySignature;
+}
+
+// Find an unused channel
+int CTrackAnalysis::findFreeChannel(int startChannel)
+{
+    int chan;
+    for (chan = startChannel; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        if (chan == Cfg::keyboardLightsChan)
+            continue;
+        if (chan == MIDI_DRUM_CHANNEL)
+            continue;
+        if (m_midiActiveChannels[chan] == false)
+            return chan;
+    }
+    return -1;      // Not found
+
+}
+
+int CTrackAnalysis::getNoteCount(int chan)
+{
+    int count = 0;
+    for (int note = 0; note < MAX_MIDI_NOTES; note++)
+        count += m_noteFrequency[chan][note];
+    return count;
+}
@@ -0,0 +1,68 @@
+/*********************************************************************************/
+/*!
+@file           TrackAnalysis.h
+
+@brief          Finds the channels, the first patches and the notes used by a song.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+#ifndef __TRACK_ANALYSIS_H__
+#define __TRACK_ANALYSIS_H__
+
+#include "MidiEvent.h"
+
+#define CONVENTION_LEFT_HAND_CHANNEL (3-1)
+#define CONVENTION_RIGHT_HAND_CHANNEL (4-1)
+
+/*!
+ * @brief   The part of the track list that only looks at the song events.
+ *
+ * It has no GUI so it can also be used by the command line tools.
+ */
+class CTrackAnalysis
+{
+public:
+    CTrackAnalysis() { clear(); }
+    virtual ~CTrackAnalysis() {}
+
+    virtual void clear();
+    void examineMidiEvent(CMidiEvent event);
+
+    // Find an unused channel
+    int findFreeChannel(int startChannel);
+
+    bool pianoPartConvetionTest();
+    int guessKeySignature(int chanA, int chanB);
+
+    bool isChannelActive(int chan) { return m_midiActiveChannels[chan]; }
+    // The first patch used on the channel, -1 if none
+    int getFirstPatch(int chan) { return m_midiFirstPatchChannels[chan]; }
+    int getNoteCount(int chan);
+
+protected:
+    bool m_midiActiveChannels[MAX_MIDI_CHANNELS];
+    int m_midiFirstPatchChannels[MAX_MIDI_CHANNELS];
+    int m_noteFrequency[MAX_MIDI_CHANNELS][MAX_MIDI_NOTES];
+};
+
+#endif //__TRACK_ANALYSIS_H__
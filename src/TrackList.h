@@ -35,9 +35,7 @@
 
 #include "MidiEvent.h"
 #include "Chord.h"
-
-#define CONVENTION_LEFT_HAND_CHANNEL (3-1)
-#define CONVENTION_RIGHT_HAND_CHANNEL (4-1)
+#include "TrackAnalysis.h"
 
 class CSong;
 class CSettings;
@@ -49,7 +47,7 @@ public:
 };
 
 
-class CTrackList
+class CTrackList : public CTrackAnalysis
 {
 public:
     CTrackList()
@@ -64,14 +62,7 @@ public:
     void refresh();
     void clear();
 
-    // Find an unused channel
-    int findFreeChannel(int startChannel);
-
-
     void currentRowChanged(int currentRow);
-    void examineMidiEvent(CMidiEvent event);
-    bool pianoPartConvetionTest();
-    int guessKeySignature(int chanA, int chanB);
 
     // The programme name now starts at 1 with 0 = "(none)"
     static QString getProgramName(int program);
@@ -92,9 +83,6 @@ private:
     CSong* m_song;
     CSettings* m_settings;
     QList<CTrackListItem> m_trackQtList;
-    bool m_midiActiveChannels[MAX_MIDI_CHANNELS];
-    int m_midiFirstPatchChannels[MAX_MIDI_CHANNELS];
-    int m_noteFrequency[MAX_MIDI_CHANNELS][MAX_MIDI_NOTES];
 };
 
 #endif //__TRACK_LIST_H__
@@ -31,6 +31,7 @@
 #include <stdarg.h>
 #include <fstream>
 #include <sstream>
+#include <chrono>
 #include "Util.h"
 #include "Cfg.h"
 #include <QTime>
@@ -79,6 +80,18 @@ static void flushLogs()
     }
 }
 
+qint64 ppTimeMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+qint64 ppTimeNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 void closeLogs()
 {
     if (logInfoFile != stdout)
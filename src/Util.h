@@ -71,6 +71,13 @@ void ppLogError(const char *msg, ...);
 void ppTiming(const char *msg, ...);
 void closeLogs();
 
+// A monotonic time in microseconds, it can be read on any thread (the midi input is time stamped with it)
+qint64 ppTimeMicros();
+// The same clock in nanoseconds, the engine is run from it
+qint64 ppTimeNanos();
+
+#define NANO_SECONDS_PER_MSEC   1000000
+
 
 #define SPEED_ADJUST_FACTOR     1000
 #define deltaAdjust(delta) ((delta)/SPEED_ADJUST_FACTOR )
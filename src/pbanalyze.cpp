@@ -0,0 +1,366 @@
+/*********************************************************************************/
+/*!
+@file           pbanalyze.cpp
+
+@brief          Command line tool that analyses a library of songs, one JSON line per song.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+/*
+ * Usage: pbanalyze [-j threads] <midi files, folders or music zip files> ...
+ *
+ * Folders (and folders inside a music zip file) are searched for songs. Each song is read with
+ * the same code as the player, so the channels, the hands convention and the key are the ones
+ * the player would pick. The songs are shared out between the threads a song at a time, so a
+ * thread that gets the short songs just takes more of them. The lines are written in the same
+ * order as the songs were found.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <QString>
+#include <QStringList>
+#include <QFileInfo>
+#include <QDir>
+#include <QMutex>
+#include <QThread>
+#include <QAtomicInt>
+#include <vector>
+
+#include "MidiFile.h"
+#include "MusicArchive.h"
+#include "TrackAnalysis.h"
+#include "Tempo.h"
+#include "Cfg.h"
+
+// Collects everything about the song while the midi file is opened
+class CSongAnalyser : public CMidiEventAnalyser
+{
+public:
+    CSongAnalyser() { clear(); }
+
+    void clear()
+    {
+        m_trackAnalysis.clear();
+        m_tempoMap.clear();
+        m_timeSigTop = 0;
+        m_timeSigBottom = 0;
+        m_keySig = NO_KEY_SIGNATURE;
+    }
+
+    void examineMidiEvent(CMidiEvent event)
+    {
+        m_trackAnalysis.examineMidiEvent(event);
+        m_tempoMap.examineMidiEvent(event);
+        if (event.type() == MIDI_PB_timeSignature && m_timeSigTop == 0)
+        {
+            m_timeSigTop = event.data1();
+            m_timeSigBottom = event.data2();
+        }
+        if (event.type() == MIDI_PB_keySignature && m_keySig == NO_KEY_SIGNATURE)
+            m_keySig = event.data1();
+    }
+
+    CTrackAnalysis m_trackAnalysis;
+    CTempoMap m_tempoMap;
+    int m_timeSigTop;
+    int m_timeSigBottom;
+    int m_keySig;
+};
+
+// The songs and their results, shared by all the threads
+class CAnalyseJob
+{
+public:
+    CAnalyseJob(const QStringList& fileNames) : m_fileNames(fileNames)
+    {
+        m_results.resize(fileNames.size());
+        m_done.resize(fileNames.size(), false);
+        m_nextToWrite = 0;
+        m_errorCount = 0;
+    }
+
+    // Returns the index of the next song to analyse, or -1 when there are no more
+    int takeSong()
+    {
+        int index = m_nextSong.fetchAndAddOrdered(1);
+        return (index < m_fileNames.size()) ? index : -1;
+    }
+
+    QString fileName(int index) { return m_fileNames.at(index); }
+
+    // Write out the results that are now in order
+    void songDone(int index, const string& result, bool failed)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_results[index] = result;
+        m_done[index] = true;
+        if (failed)
+            m_errorCount++;
+        while (m_nextToWrite < m_fileNames.size() && m_done[m_nextToWrite])
+        {
+            fputs(m_results[m_nextToWrite].c_str(), stdout);
+            m_results[m_nextToWrite].clear();
+            m_nextToWrite++;
+        }
+    }
+
+    int errorCount() { return m_errorCount; }
+
+private:
+    QStringList m_fileNames;
+    QAtomicInt m_nextSong;
+    QMutex m_mutex;                 // Guards the members below
+    vector<string> m_results;
+    vector<bool> m_done;
+    int m_nextToWrite;
+    int m_errorCount;
+};
+
+static string jsonString(const QString& text)
+{
+    QByteArray utf8 = text.toUtf8();
+    const char* chars = utf8.constData();
+    string result = "\"";
+    for (int i = 0; i < utf8.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(chars[i]);
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if (c < 0x20)
+        {
+            char escape[8];
+            sprintf(escape, "\\u%04x", c);
+            result += escape;
+        }
+        else
+            result += c;
+    }
+    return result + "\"";
+}
+
+// One thread, it keeps taking songs until there are none left
+class CAnalyseThread : public QThread
+{
+public:
+    CAnalyseThread(CAnalyseJob* job) : m_job(job)
+    {
+        // There is already a thread for each core, so don't also decode the tracks of a song at once
+        m_midiFile.setParallelDecode(false);
+        m_midiFile.setAnalyser(&m_analyser);
+    }
+
+protected:
+    void run()
+    {
+        int index;
+        while ((index = m_job->takeSong()) >= 0)
+        {
+            QString fileName = m_job->fileName(index);
+            string result;
+            bool failed = !analyseSong(fileName, &result);
+            m_job->songDone(index, result, failed);
+        }
+    }
+
+private:
+    bool analyseSong(const QString& fileName, string* result);
+
+    CAnalyseJob* m_job;
+    CMidiFile m_midiFile;
+    CSongAnalyser m_analyser;
+};
+
+bool CAnalyseThread::analyseSong(const QString& fileName, string* result)
+{
+    char buffer[100];
+
+    m_analyser.clear();
+    m_midiFile.openMidiFile(string(fileName.toLocal8Bit().data()));
+
+    *result = "{\"file\":" + jsonString(fileName);
+    midiErrors_t error = m_midiFile.getMidiError();
+    if (error != SMF_NO_ERROR)
+    {
+        *result += (error == SMF_CANNOT_OPEN_FILE) ? ",\"error\":\"cannot open\"}\n" : ",\"error\":\"corrupted\"}\n";
+        return false;
+    }
+
+    CTrackAnalysis& tracks = m_analyser.m_trackAnalysis;
+    int songTicks = m_analyser.m_tempoMap.getSongTicks();
+    int noteCount = 0;
+    string channels;
+    for (int chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        if (!tracks.isChannelActive(chan))
+            continue;
+        // The channels and patches start at 1, as they are shown in the track list
+        sprintf(buffer, "%s{\"channel\":%d,\"patch\":%d,\"notes\":%d}", channels.empty() ? "" : ",",
+                chan + 1, tracks.getFirstPatch(chan) + 1, tracks.getNoteCount(chan));
+        channels += buffer;
+        noteCount += tracks.getNoteCount(chan);
+    }
+
+    // Like the track list, the hands convention decides which channels the key is guessed from
+    bool convention = tracks.pianoPartConvetionTest();
+    int guessedKey = convention ? tracks.guessKeySignature(CONVENTION_RIGHT_HAND_CHANNEL, CONVENTION_LEFT_HAND_CHANNEL)
+                                : tracks.guessKeySignature(-1, -1);
+
+    *result += ",\"title\":" + jsonString(m_midiFile.getSongTitle());
+    sprintf(buffer, ",\"ppqn\":%d,\"ticks\":%d,\"durationMs\":%lld,\"notes\":%d", CMidiFile::getPulsesPerQuarterNote(),
+            songTicks, static_cast<long long>(m_analyser.m_tempoMap.tickToMicros(songTicks) / 1000), noteCount);
+    *result += buffer;
+    *result += ",\"channels\":[" + channels + "]";
+    *result += convention ? ",\"pianoPartConvention\":true" : ",\"pianoPartConvention\":false";
+    sprintf(buffer, ",\"guessedKey\":%d", guessedKey);
+    *result += buffer;
+    if (m_analyser.m_keySig != NO_KEY_SIGNATURE)
+    {
+        sprintf(buffer, ",\"keySignature\":%d", m_analyser.m_keySig);
+        *result += buffer;
+    }
+    // A .kar file has its lyrics in the text events
+    CSongText* songText = m_midiFile.getSongText();
+    sprintf(buffer, ",\"textEvents\":%d,\"lyrics\":%d,\"markers\":%d", songText->getCount(SONG_TEXT_text),
+            songText->getCount(SONG_TEXT_lyric), songText->getCount(SONG_TEXT_marker));
+    *result += buffer;
+    if (m_analyser.m_timeSigTop != 0)
+    {
+        sprintf(buffer, ",\"timeSignature\":\"%d/%d\"", m_analyser.m_timeSigTop, m_analyser.m_timeSigBottom);
+        *result += buffer;
+    }
+    *result += "}\n";
+    return true;
+}
+
+static bool isSongFile(const QString& name)
+{
+    return name.endsWith(".mid", Qt::CaseInsensitive) ||
+           name.endsWith(".midi", Qt::CaseInsensitive) ||
+           name.endsWith(".kar", Qt::CaseInsensitive);
+}
+
+// Add the songs in a folder and in all the folders inside it
+static void findSongs(const QString& dirName, CMusicArchive* musicArchive, QStringList* fileNames)
+{
+    QStringList names;
+    QStringList dirNames;
+    QString prefix = dirName + '/';
+
+    if (musicArchive->contains(prefix))
+    {
+        names = musicArchive->entryList(prefix, false);
+        dirNames = musicArchive->entryList(prefix, true);
+    }
+    else
+    {
+        QDir dir(dirName);
+        dir.setFilter(QDir::Files);
+        names = dir.entryList();
+        dir.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+        dirNames = dir.entryList();
+    }
+
+    for (int i = 0; i < names.size(); i++)
+    {
+        if (isSongFile(names.at(i)))
+            fileNames->append(prefix + names.at(i));
+    }
+    for (int i = 0; i < dirNames.size(); i++)
+        findSongs(prefix + dirNames.at(i), musicArchive, fileNames);
+}
+
+int main(int argc, char *argv[])
+{
+    int threadCount = QThread::idealThreadCount();
+    QStringList fileNames;
+    CMusicArchive musicArchive;
+
+    // Only the errors, and no messages about the tracks
+    Cfg::logLevel = 0;
+    CMidiTrack::setLogLevel(99);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+        {
+            threadCount = atoi(argv[++i]);
+            continue;
+        }
+        QString name = QString::fromLocal8Bit(argv[i]);
+        if (name.endsWith('/'))
+            name = name.left(name.length() - 1);
+
+        if (name.endsWith(".zip", Qt::CaseInsensitive))
+        {
+            if (musicArchive.open(name))
+                findSongs(name, &musicArchive, &fileNames);
+            else
+                fprintf(stderr, "Cannot open %s\n", argv[i]);
+        }
+        else if (CMusicArchive::splitPath(name, 0, 0) && !isSongFile(name))
+        {
+            QString zipFileName;
+            CMusicArchive::splitPath(name, &zipFileName, 0);
+            if (musicArchive.open(zipFileName))
+                findSongs(name, &musicArchive, &fileNames);
+            else
+                fprintf(stderr, "Cannot open %s\n", argv[i]);
+        }
+        else if (isSongFile(name))
+            fileNames.append(name);
+        else
+            findSongs(name, &musicArchive, &fileNames);
+    }
+
+    if (fileNames.isEmpty())
+    {
+        fprintf(stderr, "Usage: pbanalyze [-j threads] <midi files, folders or music zip files> ...\n");
+        return EXIT_FAILURE;
+    }
+    if (threadCount < 1)
+        threadCount = 1;
+    if (threadCount > fileNames.size())
+        threadCount = fileNames.size();
+
+    CAnalyseJob job(fileNames);
+    vector<CAnalyseThread*> threads;
+    for (int i = 0; i < threadCount; i++)
+    {
+        threads.push_back(new CAnalyseThread(&job));
+        threads.back()->start();
+    }
+    for (int i = 0; i < threadCount; i++)
+    {
+        threads[i]->wait();
+        delete threads[i];
+    }
+
+    fflush(stdout);
+    if (job.errorCount() > 0)
+        fprintf(stderr, "%d of %d songs could not be read\n", job.errorCount(), fileNames.size());
+    return (job.errorCount() > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
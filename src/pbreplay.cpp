@@ -0,0 +1,277 @@
+/*********************************************************************************/
+/*!
+@file           pbreplay.cpp
+
+@brief          Command line tool that plays a song in virtual time and prints what was sent to the midi output.
+
+@author         L. J. Barman
+
+    Copyright (c)   2008-2009, L. J. Barman, all rights reserved
+
+    This file is part of the PianoBooster application
+
+    PianoBooster is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    PianoBooster is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with PianoBooster.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+/*********************************************************************************/
+
+
+/*
+ * Usage: pbreplay [-t seconds] [-m listen|follow|along|rhythm] [-i input] [-x expected] [-e] <midi file>
+ *
+ * The song is played through the virtual midi device, so nothing waits for the real time and no midi
+ * port is used. Each event sent to the output is written as a line of "time channel type data1 data2",
+ * the time is in microseconds from the start and the channel starts at 1. The same song and input
+ * always give the same lines, so two builds can be compared with diff.
+ *
+ * The part is picked like the track list does. The play mode is listen unless -m gives another.
+ * The pianist's notes are read from the input file, a line of "time note velocity" for each, the
+ * time is in msec from the start and a velocity of 0 lets the note go. Lines starting with # are
+ * comments. With -x the lines are checked against the expected file instead of being written, it
+ * fails at the first one that is different.
+ *
+ * With -e the events are not written, instead the time the song stops is checked against the
+ * length its tempo map gives. It fails if the clock has drifted by more than a msec.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <QString>
+
+#include "Song.h"
+#include "MidiDeviceVirtual.h"
+#include "Cfg.h"
+
+#define REPLAY_STEP_MSEC    12  // The task is called as often as the display does it
+#define END_CHECK_MSEC      1   // How close to the tempo map the song must end
+#define END_CHECK_STEP_USEC 10  // The steps used to find when it stopped
+#define MAX_LINE_LENGTH     256
+
+// Adds the pianist's notes in the input file to the device's script
+static bool readInput(const char* fileName, CMidiDeviceVirtual* device)
+{
+    FILE* file = fopen(fileName, "r");
+    if (file == 0)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return false;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    int lineNumber = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), file) != 0)
+    {
+        lineNumber++;
+        double msec;
+        int note;
+        int velocity;
+        char first = '#';
+        if (sscanf(line, " %c", &first) != 1 || first == '#')
+            continue;
+        if (sscanf(line, "%lf %d %d", &msec, &note, &velocity) != 3 || msec < 0 ||
+                note < 0 || note >= MAX_MIDI_NOTES || velocity < 0 || velocity > 127)
+        {
+            fprintf(stderr, "%s:%d: expected \"time note velocity\"\n", fileName, lineNumber);
+            ok = false;
+            break;
+        }
+
+        CMidiEvent event;
+        if (velocity == 0)
+            event.noteOffEvent(0, 0, note, 0);
+        else
+            event.noteOnEvent(0, 0, note, velocity);
+        device->addInputEvent(static_cast<qint64>(msec * 1000), event);
+    }
+    fclose(file);
+    return ok;
+}
+
+// Checks the output lines against the expected file
+static bool checkOutput(const char* fileName, const vector<string>& lines)
+{
+    FILE* file = fopen(fileName, "r");
+    if (file == 0)
+    {
+        fprintf(stderr, "Cannot open %s\n", fileName);
+        return false;
+    }
+
+    char line[MAX_LINE_LENGTH];
+    size_t lineNumber = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file) != 0)
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        if (lineNumber >= lines.size())
+        {
+            fprintf(stderr, "%s:%d: expected \"%s\", the output has ended\n", fileName, static_cast<int>(lineNumber + 1), line);
+            ok = false;
+        }
+        else if (lines[lineNumber] != line)
+        {
+            fprintf(stderr, "%s:%d: expected \"%s\", got \"%s\"\n", fileName, static_cast<int>(lineNumber + 1), line,
+                    lines[lineNumber].c_str());
+            ok = false;
+        }
+        lineNumber++;
+    }
+    if (ok && lineNumber < lines.size())
+    {
+        fprintf(stderr, "%s: ended, the output goes on with \"%s\"\n", fileName, lines[lineNumber].c_str());
+        ok = false;
+    }
+    fclose(file);
+    if (ok)
+        printf("%d events as expected\n", static_cast<int>(lines.size()));
+    return ok;
+}
+
+// Plays the part the track list would give the pianist
+static void selectPart(CSong* song)
+{
+    CTrackAnalysis* trackAnalysis = song->getTrackAnalysis();
+    if (trackAnalysis->pianoPartConvetionTest())
+    {
+        CNote::setChannelHands(CONVENTION_LEFT_HAND_CHANNEL, CONVENTION_RIGHT_HAND_CHANNEL);
+        song->setActiveChannel(CNote::bothHandsChan());
+        return;
+    }
+    for (int chan = 0; chan < MAX_MIDI_CHANNELS; chan++)
+    {
+        if (trackAnalysis->isChannelActive(chan))
+        {
+            song->setActiveChannel(chan);
+            return;
+        }
+    }
+}
+
+// Plays the song to the end and checks that it stops when its tempo map says
+static bool checkSongEnd(CSong* song, CMidiDeviceVirtual* device)
+{
+    qint64 songLength = song->getSongLengthMicros();
+    qint64 frameNanos = REPLAY_STEP_MSEC * NANO_SECONDS_PER_MSEC;
+
+    // Nearly all of the song in frames, as the part ticks carried from frame to frame could drift
+    song->runVirtualTime(frameNanos, songLength * 1000 - 2 * frameNanos);
+    if (song->playingMusic())
+        song->runVirtualTime(END_CHECK_STEP_USEC * 1000, 4 * frameNanos);
+
+    qint64 error = device->getTime() - songLength;
+    printf("The song stopped at %lld usec, the tempo map gives %lld usec\n",
+           static_cast<long long>(device->getTime()), static_cast<long long>(songLength));
+    if (song->playingMusic())
+    {
+        fprintf(stderr, "The song did not stop\n");
+        return false;
+    }
+    if (error > END_CHECK_MSEC * 1000 || error < -END_CHECK_MSEC * 1000)
+    {
+        fprintf(stderr, "The song stopped %lld usec from the end of the tempo map\n", static_cast<long long>(error));
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    qint64 seconds = 60 * 60;
+    const char* fileName = 0;
+    const char* inputFileName = 0;
+    const char* expectedFileName = 0;
+    const char* modeName = "listen";
+    playMode_t playMode = PB_PLAY_MODE_listen;
+    bool checkEnd = false;
+
+    // Only the errors
+    Cfg::logLevel = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            seconds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+            modeName = argv[++i];
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            inputFileName = argv[++i];
+        else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc)
+            expectedFileName = argv[++i];
+        else if (strcmp(argv[i], "-e") == 0)
+            checkEnd = true;
+        else
+            fileName = argv[i];
+    }
+    if (strcmp(modeName, "follow") == 0)
+        playMode = PB_PLAY_MODE_followYou;
+    else if (strcmp(modeName, "along") == 0)
+        playMode = PB_PLAY_MODE_playAlong;
+    else if (strcmp(modeName, "rhythm") == 0)
+        playMode = PB_PLAY_MODE_rhythmTapping;
+    else if (strcmp(modeName, "listen") != 0)
+        fileName = 0;
+    if (fileName == 0 || seconds <= 0)
+    {
+        fprintf(stderr, "Usage: pbreplay [-t seconds] [-m listen|follow|along|rhythm] [-i input] [-x expected] [-e] <midi file>\n");
+        return EXIT_FAILURE;
+    }
+
+    CSong song;
+    CMidiDeviceVirtual device;
+    song.setVirtualDevice(&device);
+    song.init2(0, 0);   // No score and no settings
+    song.loadSong(QString::fromLocal8Bit(fileName));
+    if (song.getMidiError() != SMF_NO_ERROR)
+    {
+        fprintf(stderr, (song.getMidiError() == SMF_CANNOT_OPEN_FILE) ? "Cannot open %s\n" : "%s is corrupted\n", fileName);
+        return EXIT_FAILURE;
+    }
+
+    if (inputFileName != 0 && !readInput(inputFileName, &device))
+        return EXIT_FAILURE;
+
+    selectPart(&song);
+    song.setPlayMode(playMode);
+    song.playMusic(true);
+    if (checkEnd)
+    {
+        bool ok = checkSongEnd(&song, &device);
+        song.setVirtualDevice(0);
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    song.runVirtualTime(REPLAY_STEP_MSEC * NANO_SECONDS_PER_MSEC, seconds * 1000 * NANO_SECONDS_PER_MSEC);
+    song.playMusic(false);
+
+    const vector<scheduledMidiEvent_t>& output = device.getOutput();
+    vector<string> lines;
+    for (size_t i = 0; i < output.size(); i++)
+    {
+        const CMidiEvent& event = output[i].event;
+        char line[MAX_LINE_LENGTH];
+        snprintf(line, sizeof(line), "%lld %d 0x%02x %d %d", static_cast<long long>(output[i].time), event.channel() + 1,
+                 event.type(), event.data1(), event.data2());
+        lines.push_back(line);
+    }
+    song.setVirtualDevice(0);
+
+    if (expectedFileName != 0)
+        return checkOutput(expectedFileName, lines) ? EXIT_SUCCESS : EXIT_FAILURE;
+    for (size_t i = 0; i < lines.size(); i++)
+        printf("%s\n", lines[i].c_str());
+    fflush(stdout);
+    return EXIT_SUCCESS;
+}
@@ -60,8 +60,11 @@ SOURCES   = QtMain.cpp  \
             Tempo.cpp \
             MidiDevice.cpp \
             MidiDeviceRt.cpp \
+            MidiScheduler.cpp \
+            MidiDeviceVirtual.cpp \
             rtmidi/RtMidi.cpp \
             StavePosition.cpp \
+            PianistNotes.cpp \
             Score.cpp \
             Cfg.cpp \
             Piano.cpp \
@@ -69,10 +72,15 @@ SOURCES   = QtMain.cpp  \
             Scroll.cpp \
             Notation.cpp \
             TrackList.cpp \
+            TrackAnalysis.cpp \
             Rating.cpp \
             Bar.cpp \
             Settings.cpp \
             Merge.cpp \
+            SongCache.cpp \
+            SongText.cpp \
+            MusicArchive.cpp \
+            SongIndex.cpp \
 
 RC_FILE     = pianobooster.rc
 
@@ -109,6 +117,9 @@ USE_FLUIDSYNTH {
 
 QT += xml opengl widgets
 
+# zlib inflates the songs in the music zip file
+LIBS += -lz
+
 # enable the console window
 #QT+=testlib
 